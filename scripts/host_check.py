@@ -0,0 +1,48 @@
+# Host display regression check
+#
+# Runs the host build of the display code (src/host/main.cpp) with --check against the
+# golden frames in src/host/golden. Every host variant has to reproduce the same PNGs
+# byte for byte, so a change to the LCD, UI or tile code that moves a pixel fails here.
+#
+# PlatformIO: listed in extra_scripts of env:native, adds the "check" target:
+#   pio run -e native -e native_tiles -t check
+# Standalone: python3 scripts/host_check.py <program> [program...]
+#
+# After an intended change to the scenes, regenerate the frames with
+#   .pio/build/native/program --out src/host/golden
+# and check the other variant against them before committing.
+
+import os
+import subprocess
+import sys
+
+GOLDEN_DIR = os.path.join("src", "host", "golden")
+
+
+def check(programs, golden):
+    failed = []
+    for program in programs:
+        print(f"{program} --check {golden}")
+        if subprocess.call([program, "--check", golden]) != 0:
+            failed.append(program)
+    for program in failed:
+        print(f"{program}: frames differ from {golden}")
+    return not failed
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("usage: host_check.py <program> [program...]")
+        sys.exit(2)
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    sys.exit(0 if check(sys.argv[1:], os.path.join(root, GOLDEN_DIR)) else 1)
+else:
+    Import("env")  # noqa: F821 (provided by PlatformIO)
+
+    env.AddCustomTarget(  # noqa: F821
+        name="check",
+        dependencies="$BUILD_DIR/${PROGNAME}",
+        actions=[f"$BUILD_DIR/${{PROGNAME}} --check $PROJECT_DIR/{GOLDEN_DIR}"],
+        title="Check frames",
+        description="Compare the host frames with the golden PNGs",
+    )
@@ -0,0 +1,221 @@
+# PNG to RGB565 image converter for the on-target decoder (src/peripherals/image.hpp)
+#
+# Writes a 16 byte header and the pixel stream as raw, RLE or QOI coded RGB565. With
+# --format auto the smallest encoding is kept. Transparent PNG pixels (alpha < 128) are
+# replaced by the key colour and the image is flagged as a sprite, opaque pixels that
+# happen to equal the key are nudged by one blue step. Needs only the standard library,
+# reads non-interlaced 8 bit greyscale, RGB, palette and alpha PNGs.
+#
+#   python3 scripts/image_convert.py logo.png logo.img [--format rle|qoi|raw|auto] [--key F81F]
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"I565"
+FORMATS = {"raw": 0, "rle": 1, "qoi": 2}
+FLAG_TRANSPARENT = 0x01
+DEFAULT_KEY = 0xF81F
+
+
+def read_png(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("not a PNG file")
+
+    pos = 8
+    idat = bytearray()
+    palette = b""
+    transparency = b""
+    while pos < len(data):
+        length, kind = struct.unpack_from(">I4s", data, pos)
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", body)
+        elif kind == b"PLTE":
+            palette = body
+        elif kind == b"tRNS":
+            transparency = body
+        elif kind == b"IDAT":
+            idat += body
+        elif kind == b"IEND":
+            break
+    if depth != 8 or interlace != 0:
+        raise ValueError("only non-interlaced 8 bit PNGs are supported")
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+
+    raw = zlib.decompress(bytes(idat))
+    stride = width * channels
+    rows = []
+    previous = bytearray(stride)
+    pos = 0
+    for _ in range(height):
+        kind = raw[pos]
+        line = bytearray(raw[pos + 1:pos + 1 + stride])
+        pos += 1 + stride
+        for i in range(stride):
+            left = line[i - channels] if i >= channels else 0
+            up = previous[i]
+            corner = previous[i - channels] if i >= channels else 0
+            if kind == 1:
+                line[i] = (line[i] + left) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + up) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + (left + up) // 2) & 0xFF
+            elif kind == 4:
+                p = left + up - corner
+                pa, pb, pc = abs(p - left), abs(p - up), abs(p - corner)
+                predictor = left if pa <= pb and pa <= pc else up if pb <= pc else corner
+                line[i] = (line[i] + predictor) & 0xFF
+        rows.append(line)
+        previous = line
+
+    pixels = []
+    for line in rows:
+        for x in range(width):
+            px = line[x * channels:(x + 1) * channels]
+            if color == 0:
+                rgba = (px[0], px[0], px[0], 255)
+            elif color == 2:
+                rgba = (px[0], px[1], px[2], 255)
+            elif color == 3:
+                alpha = transparency[px[0]] if px[0] < len(transparency) else 255
+                rgba = tuple(palette[px[0] * 3:px[0] * 3 + 3]) + (alpha,)
+            elif color == 4:
+                rgba = (px[0], px[0], px[0], px[1])
+            else:
+                rgba = tuple(px)
+            pixels.append(rgba)
+    return width, height, pixels
+
+
+def to_rgb565(pixels, key):
+    out = []
+    transparent = False
+    for r, g, b, a in pixels:
+        if a < 128:
+            out.append(key)
+            transparent = True
+            continue
+        value = ((r * 31 + 127) // 255) << 11 | ((g * 63 + 127) // 255) << 5 | (b * 31 + 127) // 255
+        out.append(value)
+    if transparent:
+        out = [value if value != key or a < 128 else value ^ 1 for value, (_, _, _, a) in zip(out, pixels)]
+    return out, transparent
+
+
+def encode_raw(pixels):
+    return struct.pack(f"<{len(pixels)}H", *pixels)
+
+
+def encode_rle(pixels):
+    out = bytearray()
+    i = 0
+    literals = []
+
+    def flush():
+        while literals:
+            chunk = literals[:128]
+            del literals[:128]
+            out.append(len(chunk) - 1)
+            out.extend(struct.pack(f"<{len(chunk)}H", *chunk))
+
+    while i < len(pixels):
+        run = 1
+        while i + run < len(pixels) and run < 128 and pixels[i + run] == pixels[i]:
+            run += 1
+        if run >= 2:
+            flush()
+            out.append(0x80 | (run - 1))
+            out.extend(struct.pack("<H", pixels[i]))
+        else:
+            literals.append(pixels[i])
+        i += run
+    flush()
+    return bytes(out)
+
+
+def qoi_hash(pixel):
+    return ((pixel >> 11) * 3 + ((pixel >> 5) & 63) * 5 + (pixel & 31) * 7) & 63
+
+
+def wrap(value, bits):
+    half = 1 << (bits - 1)
+    return ((value + half) & ((1 << bits) - 1)) - half
+
+
+def encode_qoi(pixels):
+    out = bytearray()
+    index = [0] * 64
+    previous = 0
+    run = 0
+    for i, pixel in enumerate(pixels):
+        if pixel == previous:
+            run += 1
+            if run == 62 or i == len(pixels) - 1:
+                out.append(0xC0 | (run - 1))
+                run = 0
+            continue
+        if run:
+            out.append(0xC0 | (run - 1))
+            run = 0
+
+        slot = qoi_hash(pixel)
+        if index[slot] == pixel:
+            out.append(slot)
+            previous = pixel
+            continue
+        index[slot] = pixel
+
+        dr = wrap((pixel >> 11) - (previous >> 11), 5)
+        dg = wrap(((pixel >> 5) & 63) - ((previous >> 5) & 63), 6)
+        db = wrap((pixel & 31) - (previous & 31), 5)
+        if -2 <= dr <= 1 and -2 <= dg <= 1 and -2 <= db <= 1:
+            out.append(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2))
+        elif -32 <= dg <= 31 and -8 <= dr - dg <= 7 and -8 <= db - dg <= 7:
+            out.append(0x80 | (dg + 32))
+            out.append((dr - dg + 8) << 4 | (db - dg + 8))
+        else:
+            out.append(0xFE)
+            out.extend(struct.pack("<H", pixel))
+        previous = pixel
+    return bytes(out)
+
+
+ENCODERS = {"raw": encode_raw, "rle": encode_rle, "qoi": encode_qoi}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a PNG into an RGB565 image for Image::draw")
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("--format", choices=["raw", "rle", "qoi", "auto"], default="auto")
+    parser.add_argument("--key", default=f"{DEFAULT_KEY:04X}", help="RGB565 key colour for transparent pixels")
+    args = parser.parse_args()
+
+    width, height, rgba = read_png(args.input)
+    if width > 0xFFFF or height > 0xFFFF:
+        sys.exit("image too large")
+    key = int(args.key, 16)
+    pixels, transparent = to_rgb565(rgba, key)
+
+    names = list(ENCODERS) if args.format == "auto" else [args.format]
+    encoded = {name: ENCODERS[name](pixels) for name in names}
+    name = min(encoded, key=lambda n: len(encoded[n]))
+    stream = encoded[name]
+
+    header = struct.pack("<4sHHBBHI", MAGIC, width, height, FORMATS[name], FLAG_TRANSPARENT if transparent else 0,
+                         key if transparent else 0, len(stream))
+    with open(args.output, "wb") as f:
+        f.write(header + stream)
+
+    sizes = ", ".join(f"{n} {len(s)} B" for n, s in encoded.items())
+    print(f"{args.input}: {width}x{height}{' sprite' if transparent else ''}, {sizes}, wrote {name}")
+
+
+if __name__ == "__main__":
+    main()
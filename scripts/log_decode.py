@@ -0,0 +1,182 @@
+# Host decoder for the deferred formatting log (src/system/log.hpp)
+#
+# Reads the format records from the .log_strings section of the firmware ELF and turns
+# the binary frames on the UART back into text. Plain text output on the same port is
+# passed through unchanged, telemetry frames are skipped.
+#
+#   python3 scripts/log_decode.py .pio/build/stm32h723weact/firmware.elf capture.bin
+#   python3 scripts/log_decode.py firmware.elf --port /dev/ttyUSB0 [--baud 1500000]
+#   cat /dev/ttyUSB0 | python3 scripts/log_decode.py firmware.elf -
+
+import argparse
+import re
+import struct
+import sys
+
+FRAME_SYNC = 0xFF
+TELEMETRY_START = 0xFE  # COBS telemetry frame up to the next 0x00, see telemetry_receive.py
+LEVELS = {"T": "TRACE", "D": "DEBUG", "I": "INFO ", "W": "WARN ", "E": "ERROR", "S": "SYNC "}
+
+SPECIFIER = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXcsfFeEgGp%])")
+
+
+def read_records(elf_path):
+    # Minimal ELF32 little endian section reader, avoids a pyelftools dependency
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1:
+        raise SystemExit(f"{elf_path}: not an ELF32 file")
+
+    shoff, = struct.unpack_from("<I", elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+
+    def section(index):
+        # name, type, flags, addr, offset, size
+        return struct.unpack_from("<IIIIII", elf, shoff + index * shentsize)
+
+    names = section(shstrndx)
+    for i in range(shnum):
+        name, _, _, addr, offset, size = section(i)
+        end = elf.index(b"\0", names[4] + name)
+        if elf[names[4] + name:end] != b".log_strings":
+            continue
+
+        records = {}
+        data = elf[offset:offset + size]
+        pos = 0
+        while pos < len(data):
+            end = data.find(b"\0", pos)
+            if end < 0:
+                end = len(data)
+            if end > pos:
+                fields = data[pos:end].decode(errors="replace").split("\x1f", 3)
+                if len(fields) == 4:
+                    records[addr + pos] = fields
+            pos = end + 1
+        return records
+
+    raise SystemExit(f"{elf_path}: no .log_strings section, built without ENABLE_BINARY_LOG?")
+
+
+def decode_args(fmt, payload):
+    # Argument sizes follow the C type, see Log::Writer
+    values = []
+    pos = 0
+    for flags, length, conv in SPECIFIER.findall(fmt):
+        if conv == "%":
+            continue
+        if conv == "s":
+            n = payload[pos] if pos < len(payload) else 0
+            values.append(payload[pos + 1:pos + 1 + n].decode(errors="replace"))
+            pos += 1 + n
+        elif conv in "fFeEgG":
+            values.append(struct.unpack_from("<f", payload, pos)[0] if pos + 4 <= len(payload) else 0.0)
+            pos += 4
+        else:
+            size = 8 if length == "ll" else 4
+            raw = payload[pos:pos + size].ljust(size, b"\0")
+            signed = conv in "di"
+            values.append(int.from_bytes(raw, "little", signed=signed))
+            pos += size
+    return values
+
+
+def render(fmt, values):
+    # printf length modifiers and %p are not understood by Python's % operator
+    out = SPECIFIER.sub(lambda m: "%%" if m.group(3) == "%" else
+                        "%" + m.group(1) + ("#x" if m.group(3) == "p" else m.group(3)), fmt)
+    try:
+        return out % tuple(values)
+    except (TypeError, ValueError):
+        return f"{fmt} {values}"
+
+
+class Decoder:
+    def __init__(self, records, out):
+        self.records = records
+        self.out = out
+        self.clock = None
+        self.last = None
+        self.cycles = 0
+        self.buffer = bytearray()
+
+    def timestamp(self, stamp):
+        # Unwrap the 32 bit cycle counter, assumes frames arrive more often than it wraps
+        if self.last is not None:
+            self.cycles += (stamp - self.last) & 0xFFFFFFFF
+        self.last = stamp
+        return self.cycles / self.clock if self.clock else None
+
+    def frame(self, payload):
+        record_id, stamp = struct.unpack_from("<HI", payload, 0)
+        record = self.records.get(record_id)
+        if record is None:
+            self.out.write(f"<unknown log id {record_id:#06x}>\n")
+            return
+        level, file, line, fmt = record
+        text = render(fmt, decode_args(fmt, payload[6:]))
+        if level == "S":
+            match = re.search(r"(\d+) Hz", text)
+            self.clock = int(match.group(1)) if match else self.clock
+            self.last, self.cycles = stamp, 0
+        seconds = self.timestamp(stamp)
+        when = f"{seconds:12.6f}" if seconds is not None else f"{stamp:>12}"
+        self.out.write(f"{when} {LEVELS.get(level, level)} {file}:{line} {text}\n")
+
+    def feed(self, data):
+        self.buffer += data
+        while self.buffer:
+            if self.buffer[0] == TELEMETRY_START:
+                end = self.buffer.find(0)
+                if end < 0:
+                    break
+                del self.buffer[:end + 1]
+                continue
+            stops = [i for i in (self.buffer.find(FRAME_SYNC), self.buffer.find(TELEMETRY_START)) if i >= 0]
+            sync = min(stops) if stops else -1
+            if sync != 0:
+                text = self.buffer if sync < 0 else self.buffer[:sync]
+                self.out.write(text.decode(errors="replace"))
+                del self.buffer[:len(text)]
+                continue
+            if len(self.buffer) < 2 or len(self.buffer) < 2 + self.buffer[1]:
+                break  # wait for the rest of the frame
+            length = self.buffer[1]
+            payload = bytes(self.buffer[2:2 + length])
+            del self.buffer[:2 + length]
+            if length >= 6:
+                self.frame(payload)
+        self.out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode BeaRTOS binary log frames")
+    parser.add_argument("elf", help="firmware ELF the target is running")
+    parser.add_argument("input", nargs="?", default="-", help="capture file or - for stdin")
+    parser.add_argument("--port", help="serial port to read from instead of a file")
+    parser.add_argument("--baud", type=int, default=1500000)
+    args = parser.parse_args()
+
+    decoder = Decoder(read_records(args.elf), sys.stdout)
+
+    if args.port:
+        import serial  # pyserial, only needed for live decoding
+
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            while True:
+                decoder.feed(port.read(4096))
+    else:
+        stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+        with stream:
+            while True:
+                data = stream.read(4096)
+                if not data:
+                    break
+                decoder.feed(data)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
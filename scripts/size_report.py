@@ -0,0 +1,191 @@
+# Build-time memory size report
+#
+# Parses the linker map file and prints per-region, per-section and per-module
+# usage together with the difference to memory_budget.json and to the previous
+# build. The last report is stored next to the firmware as size_report.json so
+# footprint regressions show up as deltas on every build.
+#
+# PlatformIO: listed in extra_scripts, runs after the firmware is linked.
+# Standalone: python3 scripts/size_report.py <firmware.map> [budget.json] [previous.json]
+
+import json
+import os
+import re
+import sys
+
+# Output sections and the regions they occupy, matches stm32h723weact.ld
+SECTION_REGIONS = {
+    ".isr_vector": ["FLASH"],
+    ".itcm_text": ["ITCM", "FLASH"],
+    ".text": ["FLASH"],
+    ".rodata": ["FLASH"],
+    ".ARM.extab": ["FLASH"],
+    ".ARM": ["FLASH"],
+    ".preinit_array": ["FLASH"],
+    ".init_array": ["FLASH"],
+    ".fini_array": ["FLASH"],
+    ".dtcm_data": ["DTCM", "FLASH"],
+    ".dtcm_bss": ["DTCM"],
+    ".data": ["RAM_D1", "FLASH"],
+    ".bss": ["RAM_D1"],
+    ".axi_sram": ["RAM_D1"],
+    "._user_heap_stack": ["RAM_D1"],
+}
+
+OUTPUT_SECTION = re.compile(r"^(\.[\w.]+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+OUTPUT_SECTION_NAME = re.compile(r"^(\.[\w.]+)\s*$")
+INPUT_SECTION = re.compile(r"^ (\.[\w.]+|COMMON)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+INPUT_SECTION_NAME = re.compile(r"^ (\.[\w.]+|COMMON)\s*$")
+INPUT_SECTION_CONT = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+
+
+def module_name(path):
+    # Archive members are grouped by library, project objects by source path
+    path = path.strip()
+    archive = re.match(r"(.*\.a)\((.*)\)$", path)
+    if archive:
+        return os.path.basename(archive.group(1))
+    path = path.replace("\\", "/")
+    if "/src/" in path:
+        path = "src/" + path.split("/src/", 1)[1]
+    else:
+        path = os.path.basename(path)
+    return re.sub(r"\.o$", "", path)
+
+
+def parse_map(path):
+    sections = {}
+    modules = {}
+    current = None
+    pending = None
+    in_map = False
+
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_map = True
+                continue
+            if not in_map:
+                continue
+
+            m = OUTPUT_SECTION.match(line)
+            if m:
+                current = m.group(1)
+                sections[current] = sections.get(current, 0) + int(m.group(3), 16)
+                pending = None
+                continue
+            m = OUTPUT_SECTION_NAME.match(line)
+            if m:
+                # Long output section names wrap, size follows on the next line
+                current = m.group(1)
+                pending = ("output", current)
+                continue
+
+            if pending and pending[0] == "output":
+                m = re.match(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)", line)
+                if m:
+                    sections[current] = sections.get(current, 0) + int(m.group(2), 16)
+                pending = None
+                continue
+
+            if current not in SECTION_REGIONS:
+                continue
+
+            m = INPUT_SECTION.match(line)
+            size, obj = None, None
+            if m:
+                size, obj = int(m.group(3), 16), m.group(4)
+            elif INPUT_SECTION_NAME.match(line):
+                pending = ("input", current)
+                continue
+            elif pending and pending[0] == "input":
+                m = INPUT_SECTION_CONT.match(line)
+                if m:
+                    size, obj = int(m.group(2), 16), m.group(3)
+                pending = None
+
+            if size:
+                module = modules.setdefault(module_name(obj), {})
+                module[current] = module.get(current, 0) + size
+
+    return sections, modules
+
+
+def build_report(sections, modules):
+    regions = {}
+    for name, size in sections.items():
+        if name == "._user_heap_stack":
+            continue  # reserved stack only, heap grows at runtime
+        for region in SECTION_REGIONS.get(name, []):
+            regions[region] = regions.get(region, 0) + size
+
+    return {
+        "regions": regions,
+        "sections": {k: v for k, v in sections.items() if k in SECTION_REGIONS},
+        "modules": {k: sum(v.values()) for k, v in modules.items()},
+    }
+
+
+def load_json(path):
+    if path and os.path.isfile(path):
+        with open(path) as f:
+            return json.load(f)
+    return {}
+
+
+def print_table(title, values, budget, previous, limit=None):
+    print(f"{title:<36} {'Used':>9} {'Budget':>9} {'Left':>9} {'Delta':>8}")
+    rows = sorted(values.items(), key=lambda kv: -kv[1])
+    over = []
+    for name, used in rows[:limit] if limit else rows:
+        cap = budget.get(name)
+        delta = used - previous.get(name, used)
+        left = f"{cap - used:9d}" if cap is not None else f"{'-':>9}"
+        cap_str = f"{cap:9d}" if cap is not None else f"{'-':>9}"
+        delta_str = f"{delta:+8d}" if delta else f"{'':>8}"
+        print(f"{name[-36:]:<36} {used:9d} {cap_str} {left} {delta_str}")
+        if cap is not None and used > cap:
+            over.append(name)
+    print()
+    return over
+
+
+def report(map_path, budget_path, previous_path, output_path=None):
+    sections, modules = parse_map(map_path)
+    current = build_report(sections, modules)
+    budget = load_json(budget_path)
+    previous = load_json(previous_path)
+
+    over = []
+    over += print_table("Region", current["regions"], budget.get("regions", {}), previous.get("regions", {}))
+    over += print_table("Section", current["sections"], budget.get("sections", {}), previous.get("sections", {}))
+    over += print_table("Module (top 25)", current["modules"], budget.get("modules", {}), previous.get("modules", {}), 25)
+
+    if output_path:
+        with open(output_path, "w") as f:
+            json.dump(current, f, indent=2, sort_keys=True)
+
+    for name in over:
+        print(f"warning: {name} exceeds its memory budget")
+    return over
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("usage: size_report.py <firmware.map> [budget.json] [previous.json]")
+        sys.exit(2)
+    over = report(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else None, sys.argv[3] if len(sys.argv) > 3 else None)
+    sys.exit(1 if over else 0)
+else:
+    Import("env")  # noqa: F821 (provided by PlatformIO)
+
+    env.Append(LINKFLAGS=["-Wl,-Map,${BUILD_DIR}/firmware.map"])  # noqa: F821
+
+    def size_report_action(source, target, env):
+        build_dir = env.subst("$BUILD_DIR")
+        output = os.path.join(build_dir, "size_report.json")
+        budget = os.path.join(env.subst("$PROJECT_DIR"), "memory_budget.json")
+        report(os.path.join(build_dir, "firmware.map"), budget, output, output)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", size_report_action)  # noqa: F821
@@ -0,0 +1,158 @@
+# Host receiver for the binary telemetry channel (src/system/telemetry.hpp)
+#
+# Splits the USART1 stream into text, log frames (0xFF, skipped) and telemetry frames
+# (0xFE ... 0x00), COBS decodes the latter, checks the CRC-32 from the CRC unit and the
+# frame sequence, and prints or records the decoded channels.
+#
+#   python3 scripts/telemetry_receive.py --port /dev/ttyUSB0 [--baud 1500000] [--csv out.csv]
+#   python3 scripts/telemetry_receive.py capture.bin
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+LOG_SYNC = 0xFF
+FRAME_START = 0xFE
+
+CHANNEL_ADC = 1
+CHANNEL_TEMPERATURE = 2
+CHANNEL_TASK_STATS = 3
+
+
+def cobs_decode(data):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        if code == 0 or pos + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[pos + 1:pos + code]
+        pos += code
+        if code < 0xFF and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_channel(channel, payload):
+    if channel == CHANNEL_ADC:
+        samples = struct.unpack(f"<{len(payload) // 2}H", payload[:len(payload) // 2 * 2])
+        return "adc", " ".join(str(s) for s in samples)
+    if channel == CHANNEL_TEMPERATURE and len(payload) >= 4:
+        return "temperature", f"{struct.unpack_from('<f', payload)[0]:.1f} C"
+    if channel == CHANNEL_TASK_STATS:
+        tasks = []
+        for off in range(0, len(payload) - 7, 8):
+            task_id, load, stack = struct.unpack_from("<IHH", payload, off)
+            tasks.append(f"{task_id}:{load / 10:.1f}%/{stack * 4}B")
+        return "tasks", " ".join(tasks)
+    return f"ch{channel}", payload.hex()
+
+
+class Receiver:
+    def __init__(self, out, csv=None, show_text=False):
+        self.out = out
+        self.csv = csv
+        self.show_text = show_text
+        self.buffer = bytearray()
+        self.frames = 0
+        self.crc_errors = 0
+        self.framing_errors = 0
+        self.lost = 0
+        self.sequence = None
+        self.bytes = 0
+        self.start = time.monotonic()
+
+    def frame(self, encoded):
+        try:
+            body = cobs_decode(encoded)
+        except ValueError:
+            self.framing_errors += 1
+            return
+        if len(body) < 6:
+            self.framing_errors += 1
+            return
+
+        crc, = struct.unpack_from("<I", body, len(body) - 4)
+        if zlib.crc32(body[:-4]) != crc:
+            self.crc_errors += 1
+            return
+
+        channel, sequence = body[0], body[1]
+        if self.sequence is not None:
+            self.lost += (sequence - self.sequence - 1) & 0xFF
+        self.sequence = sequence
+        self.frames += 1
+
+        name, text = decode_channel(channel, body[2:-4])
+        self.out.write(f"{time.monotonic() - self.start:10.3f} {sequence:3d} {name:<11} {text}\n")
+        if self.csv:
+            self.csv.write(f"{time.monotonic() - self.start:.6f},{sequence},{channel},{body[2:-4].hex()}\n")
+
+    def feed(self, data):
+        self.bytes += len(data)
+        self.buffer += data
+        while self.buffer:
+            first = self.buffer[0]
+            if first == FRAME_START:
+                end = self.buffer.find(0)
+                if end < 0:
+                    break
+                self.frame(bytes(self.buffer[1:end]))
+                del self.buffer[:end + 1]
+            elif first == LOG_SYNC:
+                # Deferred log frame, decode those with log_decode.py
+                if len(self.buffer) < 2 or len(self.buffer) < 2 + self.buffer[1]:
+                    break
+                del self.buffer[:2 + self.buffer[1]]
+            else:
+                stops = [i for i in (self.buffer.find(FRAME_START), self.buffer.find(LOG_SYNC)) if i >= 0]
+                end = min(stops) if stops else len(self.buffer)
+                if self.show_text:
+                    self.out.write(self.buffer[:end].decode(errors="replace"))
+                del self.buffer[:end]
+        self.out.flush()
+
+    def summary(self):
+        elapsed = max(time.monotonic() - self.start, 1e-6)
+        return (f"{self.frames} frames, {self.lost} lost, {self.crc_errors} CRC errors, "
+                f"{self.framing_errors} framing errors, {self.bytes / elapsed / 1024:.1f} KB/s")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Receive BeaRTOS telemetry frames")
+    parser.add_argument("input", nargs="?", default="-", help="capture file or - for stdin")
+    parser.add_argument("--port", help="serial port to read from instead of a file")
+    parser.add_argument("--baud", type=int, default=1500000)
+    parser.add_argument("--csv", help="also append every frame to this CSV file")
+    parser.add_argument("--text", action="store_true", help="print console text between frames")
+    args = parser.parse_args()
+
+    csv = open(args.csv, "a") if args.csv else None
+    receiver = Receiver(sys.stdout, csv, args.text)
+    try:
+        if args.port:
+            import serial  # pyserial, only needed for live capture
+
+            with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+                while True:
+                    receiver.feed(port.read(4096))
+        else:
+            stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+            with stream:
+                while True:
+                    data = stream.read(4096)
+                    if not data:
+                        break
+                    receiver.feed(data)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print(receiver.summary(), file=sys.stderr)
+        if csv:
+            csv.close()
+
+
+if __name__ == "__main__":
+    main()
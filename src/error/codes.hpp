@@ -44,6 +44,13 @@ enum class ErrorCode : uint32_t {
   GPIO_INIT_FAILED = 0x2400,
   GPIO_CONFIG_FAILED = 0x2401,
   
+  CRC_INIT_FAILED = 0x2500,
+
+  DMA2D_INIT_FAILED = 0x2600,
+  DMA2D_TRANSFER_FAILED = 0x2601,
+
+  UI_WIDGET_LIMIT = 0x2700,
+  
   // Storage errors (0x3000-0x3FFF)
   SD_CARD_INIT_FAILED = 0x3000,
   SD_CARD_NOT_PRESENT = 0x3001,
@@ -108,6 +108,17 @@ const char *ErrorHandler::getErrorString(ErrorCode code) {
   case ErrorCode::GPIO_CONFIG_FAILED:
     return "GPIO configuration failed";
 
+  case ErrorCode::CRC_INIT_FAILED:
+    return "CRC initialization failed";
+
+  case ErrorCode::DMA2D_INIT_FAILED:
+    return "DMA2D initialization failed";
+  case ErrorCode::DMA2D_TRANSFER_FAILED:
+    return "DMA2D transfer failed";
+
+  case ErrorCode::UI_WIDGET_LIMIT:
+    return "Too many widgets on a screen";
+
   // Storage errors
   case ErrorCode::SD_CARD_INIT_FAILED:
     return "SD card initialization failed";
@@ -0,0 +1,233 @@
+// Display scenes rendered on the host through the firmware's LCD driver
+//
+//   .pio/build/native/program [--out dir] [--check dir]
+//
+// Every frame is drawn with the LCD, UI, Lines, Image and Tiles code of the firmware,
+// sent by LCD::update() over the host SPI bus into the panel model and saved as
+// <scene>-<frame>.png. The table lists the render time (drawing through LCD::update,
+// host time, good for comparing changes rather than predicting the target), the pixel
+// bytes sent and the windows the frame took. With --check nothing is written, the
+// frames are compared byte for byte with the PNGs in dir and the exit status is 1 if
+// any differ. The scenes draw the same pixels in every build configuration, so one set
+// of golden images serves env:native and env:native_tiles. That set is committed in
+// src/host/golden, pio run -e native -e native_tiles -t check runs both against it.
+
+#include "../peripherals/image.hpp"
+#include "../peripherals/lcd.hpp"
+#include "../peripherals/tiles.hpp"
+#include "../peripherals/ui.hpp"
+#include "../system/cycles.hpp"
+#include "panel.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <vector>
+
+namespace {
+constexpr uint8_t SAMPLES_PER_COLUMN = 4;
+constexpr uint8_t IMAGE_SIZE = 24;
+
+const char *outDir = "frames";
+const char *checkDir = nullptr;
+uint32_t mismatches = 0;
+
+uint32_t frameStart = 0;
+uint32_t bytesBefore = 0;
+uint32_t windowsBefore = 0;
+
+// Same layout as the display task, kept between frames like there
+UI::Screen stats;
+UI::Label lines[8];
+UI::Gauge gauge(120, 3, 36, 6, 0, 100, GREEN, GRAY);
+UI::Screen scope;
+UI::Plot plot(0, 0, LCD::WIDTH, LCD::HEIGHT - 12, 0, 1000, WHITE, BLACK);
+UI::Label caption(0, LCD::HEIGHT - 12);
+
+// Read during LCD::update() with ENABLE_LCD_TILES
+uint8_t samples[SAMPLES_PER_COLUMN * LCD::WIDTH];
+uint8_t gradient[sizeof(Image::Header) + IMAGE_SIZE * IMAGE_SIZE * 2];
+uint8_t sprite[sizeof(Image::Header) + IMAGE_SIZE * IMAGE_SIZE * 2];
+
+void beginFrame() {
+  frameStart = Cycles::now();
+  bytesBefore = LCD::bytesSent;
+  windowsBefore = Panel::getStats().windows;
+}
+
+bool sameFile(const char *path, const std::vector<uint8_t> &bytes) {
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr)
+    return false;
+  std::vector<uint8_t> golden(bytes.size() + 1);
+  size_t length = fread(golden.data(), 1, golden.size(), file);
+  fclose(file);
+  return length == bytes.size() && memcmp(golden.data(), bytes.data(), length) == 0;
+}
+
+// Sends the frame, then saves or checks what the panel shows
+void endFrame(const char *scene, uint8_t frame) {
+  LCD::update();
+  LCD::waitForDMA();
+  uint32_t micros = Cycles::toMicros(Cycles::since(frameStart));
+  uint32_t bytes = LCD::bytesSent - bytesBefore;
+  uint32_t windows = Panel::getStats().windows - windowsBefore;
+
+  char path[256];
+  const char *result = "";
+  if (checkDir) {
+    snprintf(path, sizeof(path), "%s/%s-%u.png", checkDir, scene, frame);
+    if (!sameFile(path, Panel::png())) {
+      mismatches++;
+      result = "differs";
+    }
+  } else {
+    snprintf(path, sizeof(path), "%s/%s-%u.png", outDir, scene, frame);
+    if (!Panel::savePNG(path))
+      result = "not saved";
+  }
+  printf("  %-8s %5u %10u %8u %8u %s\n", scene, frame, micros, bytes, windows, result);
+}
+
+void makeImage(uint8_t *data, bool transparent) {
+  constexpr uint16_t KEY = BRED;
+  Image::Header header = {{'I', '5', '6', '5'}, IMAGE_SIZE, IMAGE_SIZE, Image::Format::RAW,
+                          transparent ? Image::FLAG_TRANSPARENT : (uint8_t)0, KEY, IMAGE_SIZE * IMAGE_SIZE * 2};
+  memcpy(data, &header, sizeof(header));
+  uint8_t *pixels = data + sizeof(header);
+  for (int y = 0; y < IMAGE_SIZE; y++) {
+    for (int x = 0; x < IMAGE_SIZE; x++) {
+      int dx = x * 2 - IMAGE_SIZE + 1, dy = y * 2 - IMAGE_SIZE + 1;
+      uint16_t pixel = (x * 31 / (IMAGE_SIZE - 1)) << 11 | (y * 63 / (IMAGE_SIZE - 1)) << 5 | 16;
+      if (transparent)
+        pixel = dx * dx + dy * dy < IMAGE_SIZE * IMAGE_SIZE ? YELLOW : KEY;
+      pixels[(y * IMAGE_SIZE + x) * 2] = pixel & 0xFF;
+      pixels[(y * IMAGE_SIZE + x) * 2 + 1] = pixel >> 8;
+    }
+  }
+}
+
+void statsScene() {
+  const char *text[] = {"CPU: 550 MHz", "SPI: 137 MHz", "Frame: 812+3400 us 20.0Hz",
+                        "Tasks: 5",     "Heap: 42%",    "Temp: 41 C",
+                        "Uptime: 1s",   "Button: 0"};
+  for (uint8_t i = 0; i < 8; i++) {
+    lines[i].place(0, 12 * i);
+    lines[i].set(text[i]);
+    stats.add(lines[i]);
+  }
+  stats.add(gauge);
+
+  beginFrame();
+  gauge.set(42);
+  stats.render();
+  endFrame("stats", 0);
+
+  // Steady values, nothing to send
+  beginFrame();
+  stats.render();
+  endFrame("stats", 1);
+
+  // Two labels and the gauge change, one label gets shorter
+  beginFrame();
+  lines[2].set("Frame: 790 us");
+  lines[6].set("Uptime: 2s");
+  gauge.set(47);
+  stats.render();
+  endFrame("stats", 2);
+
+  beginFrame();
+  stats.scrollTo(12);
+  stats.render();
+  endFrame("stats", 3);
+}
+
+void scopeScene() {
+  scope.add(plot);
+  scope.add(caption);
+  for (uint8_t frame = 0; frame < 2; frame++) {
+    beginFrame();
+    for (uint8_t i = 0; i < LCD::WIDTH; i++)
+      plot.set(i, 500 + 400 * sin((i + frame * 8) * 0.08));
+    caption.format("Avg: %u", 500 + frame);
+    scope.render();
+    endFrame("scope", frame);
+  }
+}
+
+void linesScene() {
+  for (uint16_t i = 0; i < sizeof(samples); i++)
+    samples[i] = 40 + 30 * sin(i * 0.02) + (i * 7919 % 9) - 4;
+
+  beginFrame();
+  LCD::fillRect(0, 0, LCD::WIDTH, LCD::HEIGHT, BLACK);
+  // A fan reaching far past every edge, clipped to the screen
+  for (uint8_t i = 0; i < 16; i++) {
+    double angle = i * M_PI / 8;
+    LCD::drawLine(80, 40, 80 + 300 * cos(angle), 40 + 300 * sin(angle), i % 2 ? GRAY : DARKBLUE);
+  }
+  Lines::Point zigzag[8];
+  for (uint8_t i = 0; i < 8; i++)
+    zigzag[i] = {(int16_t)(-10 + i * 25), (int16_t)(i % 2 ? 10 : 70)};
+  LCD::drawPolyline(zigzag, 8, YELLOW);
+  LCD::drawTrace(0, 0, LCD::WIDTH, samples, sizeof(samples), GREEN);
+  endFrame("lines", 0);
+}
+
+// The second glyph only changes rows above the lowest one the first changed, the damage
+// has to keep that row
+void textScene() {
+  beginFrame();
+  LCD::fillRect(0, 0, LCD::WIDTH, LCD::HEIGHT, BLACK);
+  LCD::drawText(8, 8, "- ", Text::FONT_16, WHITE, BLACK);
+  endFrame("text", 0);
+
+  beginFrame();
+  LCD::drawText(8, 8, "_^", Text::FONT_16, WHITE, BLACK);
+  endFrame("text", 1);
+}
+
+void imageScene() {
+  makeImage(gradient, false);
+  makeImage(sprite, true);
+
+  beginFrame();
+  LCD::fillRect(0, 0, LCD::WIDTH, LCD::HEIGHT, DARKBLUE);
+  Image::draw(8, 8, gradient);
+  Image::draw(40, 30, sprite);
+  Image::draw(LCD::WIDTH - 12, LCD::HEIGHT - 12, sprite);
+  Image::draw(-12, 60, gradient);
+  endFrame("image", 0);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--out") == 0)
+      outDir = argv[i + 1];
+    else if (strcmp(argv[i], "--check") == 0)
+      checkDir = argv[i + 1];
+  }
+  if (checkDir == nullptr)
+    mkdir(outDir, 0755);
+
+  LCD::init();
+  printf("  %-8s %5s %10s %8s %8s\n", "scene", "frame", "render us", "bytes", "windows");
+  statsScene();
+  scopeScene();
+  linesScene();
+  textScene();
+  imageScene();
+
+#if ENABLE_LCD_TILES
+  if (Tiles::dropped)
+    printf("%u display list commands dropped, peak %u\n", Tiles::dropped, Tiles::commandPeak);
+#endif
+  Panel::Stats panel = Panel::getStats();
+  if (panel.hidden)
+    printf("%u pixels written outside the visible area\n", panel.hidden);
+  if (checkDir)
+    printf("%u frames differ from %s\n", mismatches, checkDir);
+  return mismatches ? 1 : 0;
+}
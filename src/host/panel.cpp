@@ -0,0 +1,171 @@
+#include "panel.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr uint8_t CASET = 0x2A;
+constexpr uint8_t RASET = 0x2B;
+constexpr uint8_t RAMWR = 0x2C;
+
+uint16_t memory[Panel::MEMORY_HEIGHT][Panel::MEMORY_WIDTH];
+uint8_t current = 0;          // last command
+uint8_t parameters[4];        // of CASET and RASET
+uint8_t received = 0;         // parameter bytes since the command
+uint16_t columns[2] = {0, Panel::MEMORY_WIDTH - 1};
+uint16_t rows[2] = {0, Panel::MEMORY_HEIGHT - 1};
+uint16_t column = 0, row = 0; // write position inside the window
+int16_t highByte = -1;        // first half of a pixel sent as bytes
+Panel::Stats stats = {};
+
+void write(uint16_t pixel) {
+  if (column < Panel::MEMORY_WIDTH && row < Panel::MEMORY_HEIGHT)
+    memory[row][column] = pixel;
+  stats.pixels++;
+  if (column < Panel::OFFSET_X || column >= Panel::OFFSET_X + Panel::WIDTH || row < Panel::OFFSET_Y ||
+      row >= Panel::OFFSET_Y + Panel::HEIGHT)
+    stats.hidden++;
+
+  // Row by row through the window, back to its first row after the last
+  if (column++ < columns[1])
+    return;
+  column = columns[0];
+  row = row < rows[1] ? row + 1 : rows[0];
+}
+
+void parameter(uint8_t byte) {
+  if (received < sizeof(parameters))
+    parameters[received] = byte;
+  if (++received != sizeof(parameters))
+    return;
+  uint16_t start = parameters[0] << 8 | parameters[1];
+  uint16_t end = parameters[2] << 8 | parameters[3];
+  if (current == CASET) {
+    columns[0] = start;
+    columns[1] = end;
+  } else if (current == RASET) {
+    rows[0] = start;
+    rows[1] = end;
+  }
+}
+
+// Stored deflate blocks inside a zlib stream, no compression library needed
+void deflateStored(std::vector<uint8_t> &out, const std::vector<uint8_t> &raw) {
+  out.push_back(0x78);
+  out.push_back(0x01);
+  uint32_t a = 1, b = 0;
+  for (size_t offset = 0; offset < raw.size(); offset += 65535) {
+    size_t length = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+    out.push_back(offset + length == raw.size());
+    out.push_back(length & 0xFF);
+    out.push_back(length >> 8);
+    out.push_back(~length & 0xFF);
+    out.push_back((~length >> 8) & 0xFF);
+    out.insert(out.end(), raw.begin() + offset, raw.begin() + offset + length);
+  }
+  for (uint8_t byte : raw) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  uint32_t adler = b << 16 | a;
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(adler >> shift);
+}
+
+uint32_t crc32(const uint8_t *data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = crc >> 1 ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+void chunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &body) {
+  uint32_t length = body.size();
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(length >> shift);
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), body.begin(), body.end());
+  uint32_t crc = crc32(&out[start], out.size() - start);
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back(crc >> shift);
+}
+} // namespace
+
+void Panel::command(uint8_t code) {
+  current = code;
+  received = 0;
+  highByte = -1;
+  stats.commands++;
+  if (code == RAMWR) {
+    column = columns[0];
+    row = rows[0];
+    stats.windows++;
+  }
+}
+
+void Panel::data(const uint8_t *bytes, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (current != RAMWR) {
+      parameter(bytes[i]);
+    } else if (highByte < 0) {
+      highByte = bytes[i];
+    } else {
+      write(highByte << 8 | bytes[i]);
+      highByte = -1;
+    }
+  }
+}
+
+void Panel::pixels(const uint16_t *pixels, uint32_t count) {
+  if (current != RAMWR)
+    return;
+  for (uint32_t i = 0; i < count; i++)
+    write(pixels[i]);
+}
+
+void Panel::visible(uint16_t *pixels) {
+  for (uint16_t y = 0; y < HEIGHT; y++)
+    memcpy(pixels + y * WIDTH, &memory[OFFSET_Y + y][OFFSET_X], WIDTH * sizeof(uint16_t));
+}
+
+Panel::Stats Panel::getStats() { return stats; }
+
+void Panel::resetStats() { stats = {}; }
+
+std::vector<uint8_t> Panel::png() {
+  // Filter type 0 and RGB888 per row, the low bits repeat the high ones
+  std::vector<uint8_t> raw;
+  raw.reserve(HEIGHT * (1 + WIDTH * 3));
+  for (uint16_t y = 0; y < HEIGHT; y++) {
+    raw.push_back(0);
+    for (uint16_t x = 0; x < WIDTH; x++) {
+      uint16_t pixel = memory[OFFSET_Y + y][OFFSET_X + x];
+      uint8_t r = pixel >> 11, g = (pixel >> 5) & 63, b = pixel & 31;
+      raw.push_back(r << 3 | r >> 2);
+      raw.push_back(g << 2 | g >> 4);
+      raw.push_back(b << 3 | b >> 2);
+    }
+  }
+
+  std::vector<uint8_t> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  std::vector<uint8_t> header = {0, 0, WIDTH >> 8, WIDTH & 0xFF, 0, 0, HEIGHT >> 8, HEIGHT & 0xFF, 8, 2, 0, 0, 0};
+  chunk(out, "IHDR", header);
+  std::vector<uint8_t> compressed;
+  deflateStored(compressed, raw);
+  chunk(out, "IDAT", compressed);
+  chunk(out, "IEND", {});
+  return out;
+}
+
+bool Panel::savePNG(const char *path) {
+  std::vector<uint8_t> bytes = png();
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr)
+    return false;
+  bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  return fclose(file) == 0 && ok;
+}
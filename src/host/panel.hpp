@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// ST7735 model for the host build
+//
+// Takes the command and data frames the LCD driver puts on the SPI bus and keeps the
+// controller's frame memory: CASET and RASET set the window, RAMWR writes pixels into
+// it row by row and wraps like the controller does, the rest of the command set is
+// accepted and ignored. The visible area sits at the offsets the driver calibrates for
+// and is saved as an RGB PNG, colours as the RGB565 written, without the inversion and
+// gamma of the glass.
+namespace Panel {
+constexpr uint16_t WIDTH = 160;
+constexpr uint16_t HEIGHT = 80;
+// Frame memory in the landscape orientation the driver's MADCTL selects
+constexpr uint16_t MEMORY_WIDTH = 162;
+constexpr uint16_t MEMORY_HEIGHT = 132;
+constexpr uint16_t OFFSET_X = 1; // first visible column and row, as in LCD::setDisplayWindow
+constexpr uint16_t OFFSET_Y = 26;
+
+struct Stats {
+  uint32_t commands;
+  uint32_t windows; // RAMWR commands
+  uint32_t pixels;  // written to frame memory
+  uint32_t hidden;  // of those outside the visible area, a window bug if not 0
+};
+
+void command(uint8_t code);
+// Parameters, or pixels as big endian byte pairs after RAMWR
+void data(const uint8_t *bytes, uint32_t count);
+// 16 bit frames after RAMWR, one pixel each
+void pixels(const uint16_t *pixels, uint32_t count);
+
+// Copies the visible area, WIDTH * HEIGHT pixels row by row
+void visible(uint16_t *pixels);
+Stats getStats();
+void resetStats();
+
+// The visible area as a PNG, stored deflate blocks make it byte for byte reproducible
+std::vector<uint8_t> png();
+bool savePNG(const char *path);
+} // namespace Panel
@@ -0,0 +1,56 @@
+// SPI bus of the host build, transactions run at once against the panel model
+//
+// Same interface as src/peripherals/spi.cpp. Nothing is queued, submit() hands every
+// frame to Panel and calls the done callbacks before it returns, so the driver's waits
+// fall straight through. Reads return zeros.
+
+#include "../peripherals/spi.hpp"
+#include "panel.hpp"
+
+#include <cstring>
+
+namespace SPI {
+SPI_HandleTypeDef hspi4;
+DMA_HandleTypeDef hdma_spi4_tx;
+DMA_HandleTypeDef hdma_spi4_rx;
+} // namespace SPI
+
+namespace {
+SPI::Stats stats = {};
+} // namespace
+
+void SPI::init() {}
+
+void SPI::initDMA() {}
+
+void SPI::submit(Device &, const Transfer *transfers, uint8_t count) {
+  stats.transactions++;
+  for (uint8_t i = 0; i < count; i++) {
+    const Transfer &transfer = transfers[i];
+    if (transfer.rx)
+      memset(transfer.rx, 0, transfer.count * (transfer.wide ? 2 : 1));
+    if (transfer.tx && transfer.command) {
+      const uint8_t *codes = (const uint8_t *)transfer.tx;
+      for (uint16_t j = 0; j < transfer.count; j++)
+        Panel::command(codes[j]);
+    } else if (transfer.tx && transfer.wide) {
+      Panel::pixels((const uint16_t *)transfer.tx, transfer.count);
+    } else if (transfer.tx) {
+      Panel::data((const uint8_t *)transfer.tx, transfer.count);
+    }
+    stats.transfers++;
+    stats.bytes += transfer.count * (transfer.wide ? 2 : 1);
+    if (transfer.done)
+      transfer.done(transfer.context, true);
+  }
+}
+
+void SPI::wait(const Device &) {}
+
+void SPI::clearFlag(void *context, bool) { *(volatile bool *)context = false; }
+
+SPI::Stats SPI::getStats() { return stats; }
+
+void SPI::transferCompleteCallback() {}
+
+void SPI::errorCallback() {}
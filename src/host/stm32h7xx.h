@@ -0,0 +1,30 @@
+#pragma once
+
+// Host build shim for the CMSIS device header
+//
+// Only what the display code touches when it is built for the host (env:native): the
+// cycle counter, the core clock and the barrier intrinsics. DWT->CYCCNT reads a
+// monotonic nanosecond clock, SystemCoreClock is 1 GHz, so Cycles measures host time.
+
+#include <cstddef>
+#include <cstdint>
+
+struct HostCycleCounter {
+  operator uint32_t() const;
+};
+
+struct DWT_Type {
+  HostCycleCounter CYCCNT;
+};
+
+extern DWT_Type *const DWT;
+extern uint32_t SystemCoreClock;
+
+inline uint32_t __get_PRIMASK() { return 0; }
+inline void __set_PRIMASK(uint32_t) {}
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+inline void __DMB() {}
+inline void __DSB() {}
+inline void __ISB() {}
+inline uint32_t __REV16(uint32_t value) { return (value & 0xFF00FF00) >> 8 | (value & 0x00FF00FF) << 8; }
@@ -0,0 +1,38 @@
+#pragma once
+
+// Host build shim for the STM32H7 HAL, the types and calls the display headers name.
+// The SPI bus and the panel behind it are replaced by src/host/spi.cpp and panel.cpp.
+
+#include "stm32h7xx.h"
+
+typedef enum { HAL_OK, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+
+uint32_t HAL_GetTick();
+void HAL_Delay(uint32_t ms);
+
+struct GPIO_TypeDef {
+  uint32_t ODR;
+};
+typedef enum { GPIO_PIN_RESET, GPIO_PIN_SET } GPIO_PinState;
+extern GPIO_TypeDef *const GPIOC;
+extern GPIO_TypeDef *const GPIOE;
+#define GPIO_PIN_3  0x0008U
+#define GPIO_PIN_11 0x0800U
+#define GPIO_PIN_13 0x2000U
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+
+struct DMA_HandleTypeDef {
+  void *Instance;
+};
+struct SPI_HandleTypeDef {
+  void *Instance;
+};
+#define SPI_DIRECTION_2LINES    0x00000000U
+#define SPI_DIRECTION_1LINE     0x00060000U
+#define SPI_POLARITY_LOW        0x00000000U
+#define SPI_POLARITY_HIGH       0x02000000U
+#define SPI_PHASE_1EDGE         0x00000000U
+#define SPI_PHASE_2EDGE         0x01000000U
+#define SPI_BAUDRATEPRESCALER_2 0x00000000U
+
+#include "stm32h7xx_hal_tim.h"
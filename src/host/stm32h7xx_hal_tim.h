@@ -0,0 +1,14 @@
+#pragma once
+
+// Host build shim, the backlight PWM keeps its compare value and nothing else
+
+#include "stm32h7xx_hal.h"
+
+struct TIM_HandleTypeDef {
+  uint32_t compare;
+};
+#define TIM_CHANNEL_2 0x00000004U
+#define __HAL_TIM_SetCompare(handle, channel, value) ((handle)->compare = (value))
+#define __HAL_TIM_GetCompare(handle, channel)        ((handle)->compare)
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef *handle, uint32_t channel);
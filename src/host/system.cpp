@@ -0,0 +1,47 @@
+// HAL, scheduler and error handler calls of the display code, for the host build
+
+#include "../error/handler.hpp"
+#include "../peripherals/timer.hpp"
+#include "../system/scheduler.hpp"
+#include "stm32h7xx_hal.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace {
+GPIO_TypeDef ports[2];
+DWT_Type dwt;
+
+uint64_t nanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+DWT_Type *const DWT = &dwt;
+uint32_t SystemCoreClock = 1000000000;
+GPIO_TypeDef *const GPIOC = &ports[0];
+GPIO_TypeDef *const GPIOE = &ports[1];
+TIM_HandleTypeDef Timer::htim1;
+
+HostCycleCounter::operator uint32_t() const { return (uint32_t)nanos(); }
+
+uint32_t HAL_GetTick() { return nanos() / 1000000; }
+
+void HAL_Delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state) {
+  port->ODR = state == GPIO_PIN_SET ? port->ODR | pin : port->ODR & ~pin;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef *, uint32_t) { return HAL_OK; }
+
+// One thread, nothing to switch to and no panel timing to wait for
+void Scheduler::yield() {}
+
+void Scheduler::yieldDelay(uint32_t) {}
+
+void ErrorHandler::handle(ErrorCode code, const char *file, int line) {
+  fprintf(stderr, "error 0x%04x at %s:%d\n", (unsigned)code, file, line);
+}
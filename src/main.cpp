@@ -25,19 +25,28 @@
 #include "error/handler.hpp"
 #include "middleware/FatFs/fatfs.hpp"
 #include "peripherals/adc.hpp"
+#include "peripherals/blitter.hpp"
+#include "peripherals/frame.hpp"
 #include "peripherals/gpio.hpp"
 #include "peripherals/lcd.hpp"
 #include "peripherals/microsd.hpp"
 #include "peripherals/spi.hpp"
 #include "peripherals/timer.hpp"
 #include "peripherals/uart.hpp"
+#include "peripherals/ui.hpp"
 #include "stm32h7xx.h"
 #include "stm32h7xx_hal.h"
 #include "system/clock.hpp"
+#include "system/cycles.hpp"
+#include "system/log.hpp"
 #include "system/memory.hpp"
 #include "system/scheduler.hpp"
+#include "system/shell.hpp"
+#include "system/stdout.hpp"
 #include "system/syscall.hpp"
+#include "system/telemetry.hpp"
 #include "system/systick.hpp"
+#include "system/tcm.hpp"
 
 #include <stdio.h>
 #include <string.h>
@@ -47,7 +56,8 @@
 extern "C" {
 
 // SystemTick interrupt handler
-void SysTick_Handler(void) {
+ITCM_FUNC void SysTick_Handler(void) {
+  SystemTick::recordEntry();
   SystemTick::handler();
   SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
 }
@@ -59,9 +69,12 @@ void _Default_Handler(void) { ErrorHandler::handle(ErrorCode::UNEXPECTED_INTERRU
 void HardFault_Handler(void) { ErrorHandler::hardFault(ErrorCode::HARD_FAULT, __FILE__, __LINE__); }
 
 // PendSV exception handler
-void PendSV_Handler(void) {
+// Must not keep locals across switchTasks, the callee-saved registers belong to the tasks
+ITCM_FUNC void PendSV_Handler(void) {
+  Scheduler::switchStart = Cycles::now();
   if (!Scheduler::active)
     return; // If scheduler is not active, do nothing, no tasks to execute
+  Scheduler::accountSwitch();
   Scheduler::updateNextTask();
   Scheduler::switchTasks();
 }
@@ -71,34 +84,74 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart) { UART::mspInit(huart); }
 
 // Redirect printf to UART
 int _write(int fd, const char *buf, int count) {
+  // stdout is buffered per task and goes straight into the lock-free UART ring
+  if (fd == FILE_STDOUT)
+    return Stdout::write(buf, count);
   syscall(SYS_WRITE, &fd, (void *)buf, &count, 0);
   return count;
 }
 
 int _read(int fd, char *buf, int count) {
+  // Waiting for input yields, which only works in thread mode, not inside the SVC
+  if (fd == FILE_STDIN)
+    return UART::read(buf, count);
   syscall(SYS_READ, &fd, (void *)buf, &count, 0);
   return count;
 }
 
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+ITCM_FUNC void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
   if (huart->Instance == USART1) {
     UART::dmaCallback();
   }
 }
 
-void DMA1_Stream0_IRQHandler(void) { HAL_DMA_IRQHandler(&SPI::hdma_spi4_tx); }
+ITCM_FUNC void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size) {
+  if (huart->Instance == USART1) {
+    UART::rxEventCallback(Size);
+  }
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+  if (huart->Instance == USART1) {
+    UART::rxErrorCallback();
+  }
+}
 
-void SPI4_IRQHandler(void) { HAL_SPI_IRQHandler(&SPI::hspi4); }
+ITCM_FUNC void DMA1_Stream0_IRQHandler(void) { HAL_DMA_IRQHandler(&SPI::hdma_spi4_tx); }
 
-void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi) {
+ITCM_FUNC void DMA1_Stream1_IRQHandler(void) { HAL_DMA_IRQHandler(&SPI::hdma_spi4_rx); }
+
+ITCM_FUNC void SPI4_IRQHandler(void) { HAL_SPI_IRQHandler(&SPI::hspi4); }
+
+ITCM_FUNC void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi) {
   if (hspi->Instance == SPI4) {
-    SPI::dmaTxCompleteCallback();
+    SPI::transferCompleteCallback();
   }
 }
 
-void USART1_IRQHandler(void) { HAL_UART_IRQHandler(&UART::huart1); }
+ITCM_FUNC void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi) {
+  if (hspi->Instance == SPI4) {
+    SPI::transferCompleteCallback();
+  }
+}
 
-void DMA1_Stream5_IRQHandler(void) { HAL_DMA_IRQHandler(&UART::hdma_usart1_tx); }
+ITCM_FUNC void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi) {
+  if (hspi->Instance == SPI4) {
+    SPI::transferCompleteCallback();
+  }
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi) {
+  if (hspi->Instance == SPI4) {
+    SPI::errorCallback();
+  }
+}
+
+ITCM_FUNC void USART1_IRQHandler(void) { HAL_UART_IRQHandler(&UART::huart1); }
+
+ITCM_FUNC void DMA1_Stream5_IRQHandler(void) { HAL_DMA_IRQHandler(&UART::hdma_usart1_tx); }
+
+ITCM_FUNC void DMA1_Stream6_IRQHandler(void) { HAL_DMA_IRQHandler(&UART::hdma_usart1_rx); }
 
 void EXTI15_10_IRQHandler(void) { HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_13); }
 
@@ -112,7 +165,7 @@ void Init_MPU() {
   MPU_Region_InitTypeDef MPU_InitStruct = {0};
   HAL_MPU_Disable();
 
-  // Configure AXI SRAM region (data only)
+  // Configure AXI SRAM region (data only), the linker script asserts .axi_sram fits in it
   MPU_InitStruct.Enable = MPU_REGION_ENABLE;
   MPU_InitStruct.BaseAddress = 0x24000000; // AXI SRAM base
   MPU_InitStruct.Size = MPU_REGION_SIZE_128KB;
@@ -151,32 +204,32 @@ void task1(void) {
     uint32_t cardBlockSize = cardInfo & 0xFFFFFFFF;
     uint64_t totalBytes = (uint64_t)cardSize * (uint64_t)cardBlockSize;
     uint32_t totalMB = totalBytes / (1024 * 1024);
-    printf("Card size: %lu blocks, %lu MB\n", cardSize, totalMB);
+    LOG_INFO("Card size: %lu blocks, %lu MB", cardSize, totalMB);
 
 #if ENABLE_FATFS
     FRESULT res = FatFs::mount("0:");
     if (res != FR_OK) {
-      printf("Failed to mount SD card: %d\n", res);
+      LOG_ERROR("Failed to mount SD card: %d", res);
       return;
     }
-    printf("Mounted SD card\n");
+    LOG_INFO("Mounted SD card");
 
     // print detailed info about the filesystem
     DWORD freeClusters;
     FATFS *fs;
     res = FatFs::getFreeSpace("0:", &freeClusters, &fs);
     if (res != FR_OK) {
-      printf("Failed to get free space: %d\n", res);
+      LOG_ERROR("Failed to get free space: %d", res);
       return;
     }
-    printf("Free space: %d MB\n", freeClusters * fs->csize / 1024 / 1024 * 512);
+    LOG_INFO("Free space: %d MB", freeClusters * fs->csize / 1024 / 1024 * 512);
 
     // list files
     DIR dir;
     FILINFO fileInfo;
     res = FatFs::openDir("0:", &dir);
     if (res != FR_OK) {
-      printf("Failed to open directory: %d\n", res);
+      LOG_ERROR("Failed to open directory: %d", res);
       return;
     }
 
@@ -202,7 +255,7 @@ void task1(void) {
     FIL file;
     res = FatFs::openFile("0:/dynamic_task.bin", &file, FA_READ);
     if (res != FR_OK) {
-      printf("Failed to open dynamic_task.bin: %d\n", res);
+      LOG_ERROR("Failed to open dynamic_task.bin: %d", res);
       return;
     }
 
@@ -212,19 +265,20 @@ void task1(void) {
     // load file into fileSize
     res = FatFs::readFile(&file, task, fileSize, nullptr);
     if (res != FR_OK) {
-      printf("Failed to read dynamic_task.bin: %d\n", res);
+      LOG_ERROR("Failed to read dynamic_task.bin: %d", res);
       return;
     }
 
     // close file
     FatFs::closeFile(&file);
 
-    // execute task
-    Scheduler::initTaskStack((void (*)(void))task, 512, "dynamic_task");
+    // execute task, the loaded image belongs to the new task so it is reclaimed when it exits
+    uint32_t taskId = Scheduler::initTaskStack((void (*)(void))task, 512, "dynamic_task");
+    Memory::setOwner(task, taskId);
 #endif // ENABLE_DYN_BIN
 
   } else {
-    printf("Card not available\n");
+    LOG_WARN("Card not available");
   }
 #else  // ENABLE_FATFS
   }
@@ -245,26 +299,28 @@ void task1(void) {
 
 // Display task
 #if ENABLE_LCD
+namespace {
+// Widgets keep their state between frames, too big for the task2 stack
+UI::Screen stats;
+UI::Label lines[12];
+UI::Label taskLines[Scheduler::MAX_TASKS];
+UI::Gauge heapGauge(120, 12 * 5 + 3, 36, 6, 0, 100, GREEN, GRAY);
+UI::Screen scope;
+UI::Plot trace(0, 0, LCD::WIDTH, LCD::HEIGHT - 12, 0, LCD::HEIGHT, WHITE, BLACK);
+UI::Label average(0, LCD::HEIGHT - 12);
+} // namespace
+
 void task2(void) {
-  // determine max possible full frame fps by drawing a black screen 10 times
-  uint32_t start = HAL_GetTick();
-  for (int i = 0; i < 10; i++) {
-    LCD::fillRect(0, 0, LCD::WIDTH, LCD::HEIGHT, BLACK);
-    LCD::update();
-  }
-  uint32_t end = HAL_GetTick();
-  uint32_t dt = (end - start) / 10;
   // get spi clock for the lcd
   PLL2_ClocksTypeDef PLL2_Clocks;
   HAL_RCCEx_GetPLL2ClockFreq(&PLL2_Clocks);
   uint32_t spi_freq = PLL2_Clocks.PLL2_Q_Frequency;
-  char string[32];
 
   // Variables for scrolling
   const uint8_t lineHeight = 12;
   const uint8_t screenHeight = LCD::HEIGHT;
   const uint8_t maxVisibleLines = screenHeight / lineHeight; // 6 lines can fit on screen
-  const uint8_t totalLines = 10;                             // Increased for more info
+  const uint8_t fixedLines = 12;                             // Lines above the per-task list
   const uint8_t scrollSpeed = 1;                             // Pixels to scroll per update
   int16_t scrollPosition = 0;
   uint32_t lastScrollTime = HAL_GetTick();
@@ -274,9 +330,6 @@ void task2(void) {
   uint32_t pauseStartTime = 0;
   bool isPaused = false;
 
-  // Calculate maximum scroll position to align last line with bottom of screen
-  const int16_t maxScrollPosition = (totalLines * lineHeight) - screenHeight;
-
   // Uptime tracking
   uint32_t startTime = HAL_GetTick();
   uint32_t lastUptimeUpdate = startTime;
@@ -284,67 +337,123 @@ void task2(void) {
 
   uint32_t buttonPresses = 0;
 
+  // UART DMA transfers and time spent in stdout per second
+  uint32_t lastTransfers = UART::getTxStats().transfers;
+  uint32_t lastLogCycles = Stdout::getStats().cycles;
+  uint32_t transfersPerSecond = 0;
+  uint32_t logMicrosPerSecond = 0;
+
+  // Stats screen, labels only redraw when their text changes
+  for (uint8_t i = 0; i < fixedLines; i++) {
+    lines[i].place(0, lineHeight * i);
+    stats.add(lines[i]);
+  }
+  for (uint8_t i = 0; i < Scheduler::MAX_TASKS; i++) {
+    taskLines[i].place(0, lineHeight * (fixedLines + i));
+    stats.add(taskLines[i]);
+  }
+  stats.add(heapGauge);
+
+  // Scope screen, only columns whose trace moved are redrawn
+  scope.add(trace);
+  scope.add(average);
+  UI::Screen *shown = nullptr;
+
+  Frame::setTargetRate(Frame::DEFAULT_RATE);
+
   while (1) {
+    // Paced at the target rate, slots a slow frame ran into are skipped
+    Frame::begin();
+
     // Update uptime
     uint32_t currentTime = HAL_GetTick();
     if (currentTime - lastUptimeUpdate >= 1000) { // Update every second
       uptimeSeconds = (currentTime - startTime) / 1000;
       lastUptimeUpdate = currentTime;
+
+      uint32_t transfers = UART::getTxStats().transfers;
+      uint32_t logCycles = Stdout::getStats().cycles;
+      transfersPerSecond = transfers - lastTransfers;
+      logMicrosPerSecond = Cycles::toMicros(logCycles - lastLogCycles);
+      lastTransfers = transfers;
+      lastLogCycles = logCycles;
     }
 
     // Get memory statistics
     Memory::MemoryRegion flash, ram, heap;
     Memory::getStats(flash, ram, heap);
 
-    // Clear the screen
-    LCD::fillRect(0, 0, LCD::WIDTH, LCD::HEIGHT, BLACK);
+    // One extra line per task for its heap usage
+    const uint8_t totalLines = fixedLines + Scheduler::taskCount;
+
+    // Calculate maximum scroll position to align last line with bottom of screen
+    const int16_t maxScrollPosition = (totalLines * lineHeight) - screenHeight;
 
     if (GPIO::wasPressed()) {
       buttonPresses++;
     }
 
-    if (buttonPresses % 2 == 0) {
-      // Draw stats with scrolling offset
+    UI::Screen *screen = buttonPresses % 2 == 0 ? &stats : &scope;
+    if (screen != shown) {
+      screen->invalidate();
+      shown = screen;
+    }
+
+    if (screen == &stats) {
+      stats.scrollTo(scrollPosition);
+
       // System Info
-      sprintf(string, "CPU: %lu MHz, SPI: %lu MHz  ", HAL_RCC_GetSysClockFreq() / 1000000, spi_freq / 1000000 / 2);
-      LCD::drawString(0, 0 - scrollPosition, 12, string);
-      sprintf(string, "Frame: %lu ms (%lu Hz)  ", dt, 1000 / dt);
-      LCD::drawString(0, lineHeight - scrollPosition, 12, string);
+      lines[0].format("CPU: %lu MHz, SPI: %lu MHz", HAL_RCC_GetSysClockFreq() / 1000000, spi_freq / 1000000 / 2);
+      Frame::Stats frame = Frame::getStats();
+      lines[1].format("Frame: %lu+%lu us %lu.%lu Hz", frame.render.last, frame.transfer.last, frame.rate10 / 10,
+                      frame.rate10 % 10);
 
       // Uptime
       uint32_t hours = uptimeSeconds / 3600;
       uint32_t minutes = (uptimeSeconds % 3600) / 60;
       uint32_t seconds = uptimeSeconds % 60;
-      sprintf(string, "Uptime: %02lu:%02lu:%02lu  ", hours, minutes, seconds);
-      LCD::drawString(0, lineHeight * 2 - scrollPosition, 12, string);
+      lines[2].format("Uptime: %02lu:%02lu:%02lu", hours, minutes, seconds);
 
       // Memory Info
-      sprintf(string, "Flash: %lu / %lu KB  ", flash.used / 1024, flash.size / 1024);
-      LCD::drawString(0, lineHeight * 3 - scrollPosition, 12, string);
-      sprintf(string, "RAM: %lu / %lu KB  ", ram.used / 1024, ram.size / 1024);
-      LCD::drawString(0, lineHeight * 4 - scrollPosition, 12, string);
-      sprintf(string, "Heap: %lu / %lu KB  ", heap.used / 1024, heap.size / 1024);
-      LCD::drawString(0, lineHeight * 5 - scrollPosition, 12, string);
+      lines[3].format("Flash: %lu / %lu KB", flash.used / 1024, flash.size / 1024);
+      lines[4].format("RAM: %lu / %lu KB", ram.used / 1024, ram.size / 1024);
+      lines[5].format("Heap: %lu / %lu KB", heap.used / 1024, heap.size / 1024);
+      heapGauge.set(heap.size ? heap.used * 100 / heap.size : 0);
 
       // Task Info
-      sprintf(string, "Tasks: %d  ", Scheduler::taskCount);
-      LCD::drawString(0, lineHeight * 6 - scrollPosition, 12, string);
+      lines[6].format("Tasks: %lu", Scheduler::taskCount);
 
       // Temperature
       float temp = ADC::getTemperature();
-      sprintf(string, "Core Temp: %d.%d C %c   ", (uint32_t)temp, (uint32_t)(temp * 10) % 10, temp > 80 ? '!' : ' ');
-      LCD::drawString(0, lineHeight * 7 - scrollPosition, 12, string);
+#if ENABLE_TELEMETRY
+      Telemetry::send(Telemetry::CHANNEL_TEMPERATURE, &temp, sizeof(temp));
+#endif
+      lines[7].format("Core Temp: %lu.%lu C %c", (uint32_t)temp, (uint32_t)(temp * 10) % 10, temp > 80 ? '!' : ' ');
 
       // Scroll position (debug)
-      sprintf(string, "Scroll: %d  ", scrollPosition);
-      LCD::drawString(0, lineHeight * 8 - scrollPosition, 12, string);
+      lines[8].format("Scroll: %d", scrollPosition);
 
       // Button pressed
-      sprintf(string, "Button: %d  ", buttonPresses);
-      LCD::drawString(0, lineHeight * 9 - scrollPosition, 12, string);
+      lines[9].format("Button: %lu", buttonPresses);
+
+      // Context switch and SysTick entry cost in cycles (last/max)
+      lines[10].format("Ctx:%lu/%lu Irq:%lu/%lu", Scheduler::switchCycles, Scheduler::switchCyclesMax,
+                       SystemTick::entryCycles, SystemTick::entryCyclesMax);
+
+      // UART transfers and stdout CPU time, compare with ENABLE_STDOUT_BUFFER=0
+      lines[11].format("Dma:%lu/s Log:%luus/s", transfersPerSecond, logMicrosPerSecond);
+
+      // Per-task heap usage
+      for (uint32_t i = 0; i < Scheduler::MAX_TASKS; i++) {
+        if (i < Scheduler::taskCount)
+          taskLines[i].format("%.12s: %lu B", Scheduler::tasks[i].name, Memory::getOwnerUsage(Scheduler::tasks[i].id));
+        else
+          taskLines[i].set("");
+      }
 
       // Update the display
-      LCD::update();
+      stats.render();
+      Frame::present();
 
       // Handle scrolling and pausing
       if (isPaused) {
@@ -384,28 +493,42 @@ void task2(void) {
       }
 
       // draw voltage across screen as pixels where height is voltage
-      uint8_t prev_voltage = 0;
       uint32_t avg = 0;
+#if ENABLE_TELEMETRY
+      // samples are written straight into telemetry records
+      Telemetry::Record *samples = nullptr;
+      size_t sampleBytes = 0;
+#endif
       for (int i = 0; i < LCD::WIDTH; i++) {
         uint32_t voltage = ADC::getVoltage();
-        uint32_t height = voltage * LCD::HEIGHT / 3300;
-        if (i == 0) {
-          prev_voltage = height;
-          continue; // dont draw, just update prev_voltage
+#if ENABLE_TELEMETRY
+        // One acquire per record, with the queue full the record's samples are skipped
+        // and it counts as one drop
+        if (sampleBytes == 0)
+          samples = Telemetry::acquire(Telemetry::CHANNEL_ADC);
+        uint16_t mv = voltage;
+        if (samples != nullptr)
+          memcpy(&samples->payload[sampleBytes], &mv, sizeof(mv));
+        sampleBytes += sizeof(mv);
+        if (sampleBytes == Telemetry::PAYLOAD_MAX || i == LCD::WIDTH - 1) {
+          if (samples != nullptr)
+            Telemetry::commit(samples, sampleBytes);
+          samples = nullptr;
+          sampleBytes = 0;
         }
-        // Invert Y coordinates by subtracting from LCD::HEIGHT
-        LCD::drawLine(i - 1, LCD::HEIGHT - prev_voltage, i, LCD::HEIGHT - height, WHITE);
-        prev_voltage = height;
-        avg += height;
+#endif
+        uint32_t height = voltage * LCD::HEIGHT / 3300;
+        trace.set(i, height);
+        if (i > 0)
+          avg += height;
       }
       avg /= LCD::WIDTH;
-      sprintf(string, "Avg: %d", avg);
-      LCD::drawString(0, LCD::HEIGHT - 12, 12, string);
+      average.format("Avg: %lu", avg);
 
       // Update the display
-      LCD::update();
+      scope.render();
+      Frame::present();
     }
-    Scheduler::yieldDelay(50);
   }
 }
 #endif
@@ -453,11 +576,17 @@ int main(void) {
   SCB_EnableDCache();
   SystemClock::init();
   SystemTick::init();
+  Cycles::init();
   GPIO::init();
   UART::init();
+  Log::init();
+#if ENABLE_TELEMETRY
+  Telemetry::init();
+#endif
   Memory::init();
   SPI::init();
   Timer::init();
+  Blitter::init();
 
 #if ENABLE_MICROSD
   MicroSD::init();
@@ -474,7 +603,7 @@ int main(void) {
   ADC::init();
   ADC::calibrate();
 
-  printf("Starting tasks\n");
+  LOG_INFO("Starting tasks");
 
   Scheduler::initTaskStack(task1, 512, "task1");
 
@@ -484,6 +613,18 @@ int main(void) {
 
   Scheduler::initTaskStack(task3, 256, "task3");
 
+#if ENABLE_HEAP_CHECK
+  Scheduler::initTaskStack(Memory::integrityTask, 256, "heapcheck");
+#endif
+
+#if ENABLE_SHELL
+  Scheduler::initTaskStack(Shell::task, 512, "shell");
+#endif
+
+#if ENABLE_TELEMETRY
+  Scheduler::initTaskStack(Telemetry::task, 256, "telemetry");
+#endif
+
   Scheduler::start();
 
   // will not get here ideally
@@ -0,0 +1,259 @@
+#include "blitter.hpp"
+
+#include "../error/handler.hpp"
+#include "../system/scheduler.hpp"
+
+#include <atomic>
+#include <cstring>
+
+namespace Blitter {
+#if ENABLE_DMA2D
+DMA2D_HandleTypeDef hdma2d;
+#endif
+Backend backend = Backend::AUTO;
+std::atomic<bool> dma2dBusy{false}; // one task at a time programs the DMA2D
+} // namespace Blitter
+
+namespace {
+constexpr uint32_t DMA2D_TIMEOUT = 100; // ms, a full screen takes well under one
+
+// Fills count pixels, aligns to a double word and then stores four pixels per STRD
+inline void fillRow(uint16_t *dst, uint32_t count, uint16_t color) {
+  if (count && ((uintptr_t)dst & 2)) {
+    *dst++ = color;
+    count--;
+  }
+  uint32_t pattern = color | (uint32_t)color << 16;
+  uint32_t *words = (uint32_t *)dst;
+  if (count >= 2 && ((uintptr_t)words & 4)) {
+    *words++ = pattern;
+    count -= 2;
+  }
+
+  uint64_t wide = pattern | (uint64_t)pattern << 32;
+  uint64_t *dwords = (uint64_t *)words;
+  for (; count >= 16; count -= 16) {
+    dwords[0] = wide;
+    dwords[1] = wide;
+    dwords[2] = wide;
+    dwords[3] = wide;
+    dwords += 4;
+  }
+  for (; count >= 4; count -= 4)
+    *dwords++ = wide;
+
+  words = (uint32_t *)dwords;
+  if (count >= 2) {
+    *words++ = pattern;
+    count -= 2;
+  }
+  if (count)
+    *(uint16_t *)words = color;
+}
+
+// RGB565 with green moved to the upper half, all three fields scale by a 5 bit alpha at once
+inline uint16_t blendPixel(uint16_t fg, uint16_t bg, uint32_t alpha) {
+  uint32_t f = (fg | (uint32_t)fg << 16) & 0x07E0F81F;
+  uint32_t b = (bg | (uint32_t)bg << 16) & 0x07E0F81F;
+  uint32_t r = ((f * alpha + b * (32 - alpha)) >> 5) & 0x07E0F81F;
+  return r | r >> 16;
+}
+
+#if ENABLE_DMA2D
+// The DMA2D is an AXI master, ITCM and DTCM are out of its reach
+bool reachable(const void *p) {
+  uint32_t address = (uint32_t)p;
+  return address >= 0x00010000 && (address < 0x20000000 || address >= 0x20020000);
+}
+
+bool useDma2d(uint32_t pixels, const void *dst, const void *src) {
+  if (Blitter::backend == Blitter::Backend::CPU || !reachable(dst) || (src && !reachable(src)))
+    return false;
+  return Blitter::backend == Blitter::Backend::DMA2D || pixels >= Blitter::DMA2D_MIN_PIXELS;
+}
+
+// Cache lines spanned by a rectangle, the stride gaps in between are included
+void area(const uint16_t *p, uint16_t stride, uint16_t width, uint16_t height, uint32_t *&start, int32_t &size) {
+  uint32_t first = (uint32_t)p & ~31u;
+  uint32_t end = (uint32_t)(p + (height - 1) * stride + width);
+  start = (uint32_t *)first;
+  size = end - first;
+}
+
+void begin(uint32_t mode, uint16_t outputOffset, bool swap) {
+  while (Blitter::dma2dBusy.exchange(true, std::memory_order_acquire))
+    Scheduler::yield();
+
+  Blitter::hdma2d.Init.Mode = mode;
+  Blitter::hdma2d.Init.ColorMode = DMA2D_OUTPUT_RGB565;
+  Blitter::hdma2d.Init.OutputOffset = outputOffset;
+  Blitter::hdma2d.Init.AlphaInverted = DMA2D_REGULAR_ALPHA;
+  Blitter::hdma2d.Init.RedBlueSwap = DMA2D_RB_REGULAR;
+  Blitter::hdma2d.Init.BytesSwap = swap ? DMA2D_BYTES_SWAP : DMA2D_BYTES_REGULAR;
+  Blitter::hdma2d.Init.LineOffsetMode = DMA2D_LOM_PIXELS;
+  if (HAL_DMA2D_Init(&Blitter::hdma2d) != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::DMA2D_INIT_FAILED, __FILE__, __LINE__);
+  }
+}
+
+void layer(uint32_t index, uint16_t inputOffset, uint32_t alphaMode, uint8_t alpha) {
+  DMA2D_LayerCfgTypeDef config = {0};
+  config.InputOffset = inputOffset;
+  config.InputColorMode = DMA2D_INPUT_RGB565;
+  config.AlphaMode = alphaMode;
+  config.InputAlpha = alpha;
+  config.AlphaInverted = DMA2D_REGULAR_ALPHA;
+  config.RedBlueSwap = DMA2D_RB_REGULAR;
+  config.ChromaSubSampling = DMA2D_NO_CSS;
+  if (HAL_DMA2D_ConfigLayer(&Blitter::hdma2d, &config, index) != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::DMA2D_INIT_FAILED, __FILE__, __LINE__);
+  }
+}
+
+// Waits for the transfer, then drops the stale destination lines from the D-cache
+void finish(HAL_StatusTypeDef started, uint32_t *start, int32_t size) {
+  if (started != HAL_OK || HAL_DMA2D_PollForTransfer(&Blitter::hdma2d, DMA2D_TIMEOUT) != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::DMA2D_TRANSFER_FAILED, __FILE__, __LINE__);
+  }
+  SCB_InvalidateDCache_by_Addr(start, size);
+  Blitter::dma2dBusy.store(false, std::memory_order_release);
+}
+#endif
+} // namespace
+
+void Blitter::init() {
+#if ENABLE_DMA2D
+  __HAL_RCC_DMA2D_CLK_ENABLE();
+  hdma2d.Instance = DMA2D;
+#endif
+}
+
+void Blitter::setBackend(Backend mode) { backend = mode; }
+
+void Blitter::fill(uint16_t *dst, uint16_t stride, uint16_t width, uint16_t height, uint16_t color) {
+  if (width == 0 || height == 0)
+    return;
+
+#if ENABLE_DMA2D
+  if (useDma2d(width * height, dst, nullptr)) {
+    uint32_t *start;
+    int32_t size;
+    area(dst, stride, width, height, start, size);
+    // Write-back lines must not land on top of the result later
+    SCB_CleanDCache_by_Addr(start, size);
+
+    begin(DMA2D_R2M, stride - width, false);
+    // Register to memory takes the colour as ARGB8888 and converts it to the output format
+    uint32_t argb = 0xFF000000 | (color & 0xF800) << 8 | (color & 0x07E0) << 5 | (color & 0x001F) << 3;
+    finish(HAL_DMA2D_Start(&hdma2d, argb, (uint32_t)dst, width, height), start, size);
+    return;
+  }
+#endif
+
+  if (width == stride) {
+    // Contiguous rows fill as one run
+    fillRow(dst, (uint32_t)width * height, color);
+    return;
+  }
+  for (uint16_t row = 0; row < height; row++)
+    fillRow(dst + row * stride, width, color);
+}
+
+void Blitter::copy(uint16_t *dst, uint16_t dstStride, const uint16_t *src, uint16_t srcStride, uint16_t width,
+                   uint16_t height) {
+  if (width == 0 || height == 0)
+    return;
+
+#if ENABLE_DMA2D
+  if (useDma2d(width * height, dst, src)) {
+    uint32_t *start, *srcStart;
+    int32_t size, srcSize;
+    area(dst, dstStride, width, height, start, size);
+    area(src, srcStride, width, height, srcStart, srcSize);
+    SCB_CleanDCache_by_Addr(srcStart, srcSize);
+    SCB_CleanDCache_by_Addr(start, size);
+
+    begin(DMA2D_M2M, dstStride - width, false);
+    layer(DMA2D_FOREGROUND_LAYER, srcStride - width, DMA2D_NO_MODIF_ALPHA, 0xFF);
+    finish(HAL_DMA2D_Start(&hdma2d, (uint32_t)src, (uint32_t)dst, width, height), start, size);
+    return;
+  }
+#endif
+
+  // newlib memcpy moves words once both pointers are aligned
+  for (uint16_t row = 0; row < height; row++)
+    memcpy(dst + row * dstStride, src + row * srcStride, width * sizeof(uint16_t));
+}
+
+void Blitter::blend(uint16_t *dst, uint16_t dstStride, const uint16_t *src, uint16_t srcStride, uint16_t width,
+                    uint16_t height, uint8_t alpha) {
+  if (width == 0 || height == 0 || alpha == 0)
+    return;
+  if (alpha == 0xFF) {
+    copy(dst, dstStride, src, srcStride, width, height);
+    return;
+  }
+
+#if ENABLE_DMA2D
+  if (useDma2d(width * height, dst, src)) {
+    uint32_t *start, *srcStart;
+    int32_t size, srcSize;
+    area(dst, dstStride, width, height, start, size);
+    area(src, srcStride, width, height, srcStart, srcSize);
+    SCB_CleanDCache_by_Addr(srcStart, srcSize);
+    SCB_CleanDCache_by_Addr(start, size);
+
+    // Foreground is the source with a constant alpha, background is the destination itself
+    begin(DMA2D_M2M_BLEND, dstStride - width, false);
+    layer(DMA2D_FOREGROUND_LAYER, srcStride - width, DMA2D_REPLACE_ALPHA, alpha);
+    layer(DMA2D_BACKGROUND_LAYER, dstStride - width, DMA2D_NO_MODIF_ALPHA, 0xFF);
+    finish(HAL_DMA2D_BlendingStart(&hdma2d, (uint32_t)src, (uint32_t)dst, (uint32_t)dst, width, height), start,
+           size);
+    return;
+  }
+#endif
+
+  uint32_t alpha5 = (alpha + 4) >> 3;
+  for (uint16_t row = 0; row < height; row++) {
+    uint16_t *d = dst + row * dstStride;
+    const uint16_t *s = src + row * srcStride;
+    for (uint16_t col = 0; col < width; col++)
+      d[col] = blendPixel(s[col], d[col], alpha5);
+  }
+}
+
+void Blitter::swapBytes(uint16_t *dst, uint16_t dstStride, const uint16_t *src, uint16_t srcStride, uint16_t width,
+                        uint16_t height) {
+  if (width == 0 || height == 0)
+    return;
+
+#if ENABLE_DMA2D
+  if (useDma2d(width * height, dst, src)) {
+    uint32_t *start, *srcStart;
+    int32_t size, srcSize;
+    area(dst, dstStride, width, height, start, size);
+    area(src, srcStride, width, height, srcStart, srcSize);
+    SCB_CleanDCache_by_Addr(srcStart, srcSize);
+    SCB_CleanDCache_by_Addr(start, size);
+
+    // Pixel format conversion between identical formats, the output stage swaps the bytes
+    begin(DMA2D_M2M_PFC, dstStride - width, true);
+    layer(DMA2D_FOREGROUND_LAYER, srcStride - width, DMA2D_NO_MODIF_ALPHA, 0xFF);
+    finish(HAL_DMA2D_Start(&hdma2d, (uint32_t)src, (uint32_t)dst, width, height), start, size);
+    return;
+  }
+#endif
+
+  for (uint16_t row = 0; row < height; row++) {
+    uint16_t *d = dst + row * dstStride;
+    const uint16_t *s = src + row * srcStride;
+    uint16_t col = 0;
+    if ((((uintptr_t)d | (uintptr_t)s) & 2) == 0) {
+      // Two pixels per REV16
+      for (; col + 1 < width; col += 2)
+        *(uint32_t *)&d[col] = __REV16(*(const uint32_t *)&s[col]);
+    }
+    for (; col < width; col++)
+      d[col] = (uint16_t)(s[col] >> 8 | s[col] << 8);
+  }
+}
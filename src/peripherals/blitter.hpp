@@ -0,0 +1,42 @@
+#pragma once
+
+#include "stm32h7xx.h"
+#include "stm32h7xx_hal.h"
+
+#include <cstdint>
+
+#ifndef ENABLE_DMA2D
+#define ENABLE_DMA2D 0
+#endif
+
+// RGB565 fill, copy, blend and byte swap on rectangular pixel areas
+//
+// Buffers are addressed by their first pixel and a stride in pixels, so the same calls
+// work on the framebuffer, tiles and images. With ENABLE_DMA2D areas of at least
+// DMA2D_MIN_PIXELS go through the Chrom-ART accelerator, smaller ones and buffers the
+// DMA2D cannot reach (DTCM) use the CPU with word and double word stores. Every call
+// returns once the pixels are written. Not for use from interrupts.
+namespace Blitter {
+// Below this the DMA2D setup costs more than the CPU loop, see 'lcd bench'
+constexpr uint32_t DMA2D_MIN_PIXELS = 512;
+
+enum class Backend : uint8_t { AUTO, CPU, DMA2D };
+
+void init();
+void fill(uint16_t *dst, uint16_t stride, uint16_t width, uint16_t height, uint16_t color);
+void copy(uint16_t *dst, uint16_t dstStride, const uint16_t *src, uint16_t srcStride, uint16_t width,
+          uint16_t height);
+// dst = src * alpha + dst * (255 - alpha)
+void blend(uint16_t *dst, uint16_t dstStride, const uint16_t *src, uint16_t srcStride, uint16_t width,
+           uint16_t height, uint8_t alpha);
+// Copies while swapping the two bytes of each pixel, for big endian RGB565 such as image files
+void swapBytes(uint16_t *dst, uint16_t dstStride, const uint16_t *src, uint16_t srcStride, uint16_t width,
+               uint16_t height);
+
+// Forces one backend, for benchmarks
+void setBackend(Backend backend);
+
+#if ENABLE_DMA2D
+extern DMA2D_HandleTypeDef hdma2d;
+#endif
+} // namespace Blitter
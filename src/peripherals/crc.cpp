@@ -0,0 +1,28 @@
+#include "crc.hpp"
+
+#include "../error/handler.hpp"
+
+namespace CRC32 {
+CRC_HandleTypeDef hcrc;
+}
+
+void CRC32::init() {
+  __HAL_RCC_CRC_CLK_ENABLE();
+
+  // Reflected in and out with the default polynomial and init value gives the zlib CRC-32
+  // once the result is inverted, so hosts can check frames with any stock crc32()
+  hcrc.Instance = CRC;
+  hcrc.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_ENABLE;
+  hcrc.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_ENABLE;
+  hcrc.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_BYTE;
+  hcrc.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_ENABLE;
+  hcrc.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
+
+  if (HAL_CRC_Init(&hcrc) != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::CRC_INIT_FAILED, __FILE__, __LINE__);
+  }
+}
+
+uint32_t CRC32::calculate(const void *data, size_t length) {
+  return HAL_CRC_Calculate(&hcrc, (uint32_t *)data, length) ^ 0xFFFFFFFF;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "stm32h7xx.h"
+#include "stm32h7xx_hal.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CRC32 {
+void init();
+// Standard CRC-32 (zlib, Ethernet) over bytes, computed by the CRC unit. Not reentrant.
+uint32_t calculate(const void *data, size_t length);
+
+extern CRC_HandleTypeDef hcrc;
+} // namespace CRC32
@@ -0,0 +1,112 @@
+#include "frame.hpp"
+
+#if ENABLE_LCD
+
+#include "../system/cycles.hpp"
+#include "../system/scheduler.hpp"
+#include "lcd.hpp"
+
+#include <cstring>
+
+namespace {
+uint32_t period = 1000 / Frame::DEFAULT_RATE; // ms, 0 is unpaced
+uint32_t nextSlot = 0;                         // tick the next frame may start at
+bool paced = false;                            // nextSlot holds a valid slot
+uint32_t renderStart = 0;                      // cycles
+uint32_t transferStart = 0;
+bool transferPending = false; // a presented frame whose transfer time is not known yet
+uint32_t windowStart = 0;     // tick, start of the current rate window
+uint32_t windowFrames = 0;
+Frame::Stats stats = {Frame::DEFAULT_RATE};
+
+void record(Frame::Histogram &histogram, uint32_t micros) {
+  uint8_t bin = 0;
+  while (bin < Frame::HISTOGRAM_BINS - 1 && micros >= Frame::FIRST_BIN_MICROS << bin)
+    bin++;
+  histogram.bins[bin]++;
+  histogram.count++;
+  histogram.last = micros;
+  histogram.max = micros > histogram.max ? micros : histogram.max;
+  histogram.total += micros;
+}
+
+// Records the transfer time of the last frame once the bus is done with it
+void settle() {
+  if (!transferPending || SPI::busy(LCD::device))
+    return;
+  record(stats.transfer, Cycles::toMicros(LCD::sentCycles - transferStart));
+  transferPending = false;
+}
+} // namespace
+
+void Frame::setTargetRate(uint32_t rate) {
+  period = rate > 0 ? 1000 / rate : 0;
+  stats.targetRate = rate;
+  paced = false;
+}
+
+void Frame::begin() {
+  uint32_t now = HAL_GetTick();
+  if (period > 0 && !paced) {
+    nextSlot = now;
+    paced = true;
+  }
+
+  if (period > 0) {
+    int32_t early = (int32_t)(nextSlot - now);
+    if (early > 0) {
+      Scheduler::yieldDelay(early);
+    } else if ((uint32_t)-early >= period) {
+      // Overran by whole slots, drop them instead of drawing the backlog back to back
+      uint32_t missed = (uint32_t)-early / period;
+      stats.skipped += missed;
+      nextSlot += missed * period;
+    }
+    nextSlot += period;
+  }
+
+#if !ENABLE_LCD_DOUBLE_BUFFER && !ENABLE_LCD_TILES
+  LCD::waitForDMA();
+#endif
+  settle();
+  renderStart = Cycles::now();
+}
+
+void Frame::present() {
+#if ENABLE_LCD_DOUBLE_BUFFER
+  // update() waits for the previous frame before swapping, measure it first
+  LCD::waitForDMA();
+#endif
+  settle();
+
+  uint32_t frames = LCD::frameCount;
+  uint32_t start = Cycles::now();
+  LCD::update();
+  record(stats.render, Cycles::toMicros(Cycles::since(renderStart)));
+  // Nothing changed, nothing was sent
+  if (LCD::frameCount != frames) {
+    transferStart = start;
+    transferPending = true;
+  }
+
+  stats.frames++;
+  windowFrames++;
+  uint32_t now = HAL_GetTick();
+  if (now - windowStart >= 1000) {
+    stats.rate10 = windowFrames * 10000 / (now - windowStart);
+    windowFrames = 0;
+    windowStart = now;
+  }
+}
+
+Frame::Stats Frame::getStats() { return stats; }
+
+void Frame::resetStats() {
+  uint32_t rate = stats.targetRate;
+  memset(&stats, 0, sizeof(stats));
+  stats.targetRate = rate;
+}
+
+uint32_t Frame::binLimit(uint8_t bin) { return bin < HISTOGRAM_BINS - 1 ? FIRST_BIN_MICROS << bin : 0; }
+
+#endif
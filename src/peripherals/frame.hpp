@@ -0,0 +1,55 @@
+#pragma once
+
+#if ENABLE_LCD
+
+#include <cstdint>
+
+// Frame pacing for the display task
+//
+// begin() waits for the next frame slot at the target rate, present() queues what the
+// frame drew. A frame that overruns does not make the following ones hurry: the slots it
+// covered are skipped and drawing resumes at the next one, so the display never costs
+// more than the target rate. With a single framebuffer begin() also waits until the
+// previous frame has left it, full-width rows are sent from the framebuffer in place and
+// drawing into them would tear.
+//
+// Render time runs from begin() returning until LCD::update() returns, which includes
+// the staging copies or, with ENABLE_LCD_TILES, rendering the bands. Transfer time runs
+// from LCD::update() until the last pixel of the frame left the bus. A frame still on
+// the bus when the next one is presented is not measured.
+namespace Frame {
+constexpr uint32_t DEFAULT_RATE = 20; // frames per second, 0 runs frames back to back
+constexpr uint8_t HISTOGRAM_BINS = 12;
+// Bin 0 holds times below this, bin i up to FIRST_BIN_MICROS << i, the last one the rest
+constexpr uint32_t FIRST_BIN_MICROS = 64;
+
+struct Histogram {
+  uint32_t bins[HISTOGRAM_BINS];
+  uint32_t count;
+  uint32_t last; // microseconds
+  uint32_t max;
+  uint64_t total;
+};
+
+struct Stats {
+  uint32_t targetRate;
+  uint32_t rate10;  // frames presented during the last full second, in 0.1 Hz
+  uint32_t frames;  // presented since the last reset
+  uint32_t skipped; // slots dropped because a frame overran
+  Histogram render;
+  Histogram transfer;
+};
+
+void setTargetRate(uint32_t rate);
+// Waits for the next slot, drawing for the frame starts after it returns
+void begin();
+// Queues the frame with LCD::update(), returns while it is sent
+void present();
+Stats getStats();
+// Clears the counters and histograms, the target rate stays
+void resetStats();
+// Upper bound of a histogram bin in microseconds, 0 for the open last bin
+uint32_t binLimit(uint8_t bin);
+} // namespace Frame
+
+#endif
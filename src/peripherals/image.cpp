@@ -0,0 +1,282 @@
+#include "image.hpp"
+
+#if ENABLE_LCD
+
+#include "lcd.hpp"
+#include "tiles.hpp"
+
+#include <cstring>
+
+namespace {
+// Bytes of the pixel stream, [pos, end) is buffered and left more follow
+struct Source {
+  const uint8_t *pos;
+  const uint8_t *end;
+  uint32_t left;
+  bool (*refill)(Source &source);
+};
+
+bool endOfMemory(Source &) { return false; }
+
+inline bool next(Source &source, uint8_t &byte) {
+  if (source.pos == source.end && !source.refill(source))
+    return false;
+  byte = *source.pos++;
+  return true;
+}
+
+inline bool nextPixel(Source &source, uint16_t &pixel) {
+  uint8_t low, high;
+  if (!next(source, low) || !next(source, high))
+    return false;
+  pixel = low | high << 8;
+  return true;
+}
+
+// Places the decoded pixels into the canvas row by row, clipped, skipping the key
+class Writer {
+public:
+  Writer(const Text::Canvas &canvas, int16_t x, int16_t y, const Image::Header &header)
+      : canvas(canvas), y(y), width(header.width), offset(x - canvas.x),
+        transparent(header.flags & Image::FLAG_TRANSPARENT), key(header.key) {
+    int32_t below = canvas.y + canvas.height - y;
+    rows = below < 0 ? 0 : below > header.height ? header.height : below;
+    left = canvas.x > x ? canvas.x - x : 0;
+    right = canvas.x + canvas.width - x < width ? canvas.x + canvas.width - x : width;
+    startRow();
+  }
+
+  // Every row the canvas shows is written, the rest of the stream is not needed
+  bool done() const { return row >= rows; }
+
+  void put(uint16_t pixel) {
+    if (visible && col >= left && col < right && !(transparent && pixel == key))
+      line[col + offset] = pixel;
+    if (++col == width)
+      nextRow();
+  }
+
+  void run(uint16_t pixel, uint32_t count) {
+    bool drawn = !(transparent && pixel == key);
+    while (count > 0 && row < rows) {
+      int32_t n = width - col < (int32_t)count ? width - col : count;
+      if (visible && drawn) {
+        int32_t from = col > left ? col : left;
+        int32_t to = col + n < right ? col + n : right;
+        for (int32_t i = from; i < to; i++)
+          line[i + offset] = pixel;
+      }
+      col += n;
+      count -= n;
+      if (col == width)
+        nextRow();
+    }
+  }
+
+private:
+  void startRow() {
+    int32_t canvasRow = y + row - canvas.y;
+    visible = row < rows && canvasRow >= 0 && left < right;
+    line = visible ? canvas.pixels + canvasRow * canvas.stride : nullptr;
+  }
+
+  void nextRow() {
+    col = 0;
+    row++;
+    startRow();
+  }
+
+  const Text::Canvas &canvas;
+  int16_t y;
+  int32_t width;
+  int32_t offset; // canvas column of image column 0
+  bool transparent;
+  uint16_t key;
+  int32_t rows;  // image rows above the canvas bottom
+  int32_t left;  // visible image columns [left, right)
+  int32_t right;
+  int32_t row = 0;
+  int32_t col = 0;
+  bool visible = false;
+  uint16_t *line = nullptr;
+};
+
+ITCM_FUNC void decodeRaw(Source &source, Writer &writer) {
+  uint16_t pixel;
+  while (!writer.done() && nextPixel(source, pixel))
+    writer.put(pixel);
+}
+
+ITCM_FUNC void decodeRLE(Source &source, Writer &writer) {
+  uint8_t control;
+  uint16_t pixel;
+  while (!writer.done() && next(source, control)) {
+    if (control & 0x80) {
+      if (!nextPixel(source, pixel))
+        return;
+      writer.run(pixel, (control & 0x7F) + 1);
+      continue;
+    }
+    for (uint8_t i = 0; i <= control; i++) {
+      if (!nextPixel(source, pixel))
+        return;
+      writer.put(pixel);
+    }
+  }
+}
+
+inline uint8_t hash(uint16_t pixel) { return ((pixel >> 11) * 3 + ((pixel >> 5) & 63) * 5 + (pixel & 31) * 7) & 63; }
+
+// Adds wrapping differences to the three channels
+inline uint16_t shift(uint16_t pixel, int32_t red, int32_t green, int32_t blue) {
+  uint16_t r = ((pixel >> 11) + red) & 31;
+  uint16_t g = (((pixel >> 5) & 63) + green) & 63;
+  uint16_t b = ((pixel & 31) + blue) & 31;
+  return r << 11 | g << 5 | b;
+}
+
+ITCM_FUNC void decodeQOI(Source &source, Writer &writer) {
+  uint16_t index[64] = {};
+  uint16_t pixel = 0;
+  uint8_t op, extra;
+  while (!writer.done() && next(source, op)) {
+    if (op == 0xFE) {
+      if (!nextPixel(source, pixel))
+        return;
+    } else if (op >> 6 == 0) {
+      writer.put(index[op]);
+      pixel = index[op];
+      continue;
+    } else if (op >> 6 == 1) {
+      pixel = shift(pixel, ((op >> 4) & 3) - 2, ((op >> 2) & 3) - 2, (op & 3) - 2);
+    } else if (op >> 6 == 2) {
+      if (!next(source, extra))
+        return;
+      int32_t green = (op & 63) - 32;
+      pixel = shift(pixel, green + (extra >> 4) - 8, green, green + (extra & 15) - 8);
+    } else {
+      writer.run(pixel, (op & 63) + 1);
+      continue;
+    }
+    index[hash(pixel)] = pixel;
+    writer.put(pixel);
+  }
+}
+
+bool valid(const Image::Header &header) {
+  return memcmp(header.magic, Image::MAGIC, sizeof(header.magic)) == 0 && header.format <= Image::Format::QOI &&
+         header.width > 0 && header.height > 0;
+}
+
+void decodeStream(Source &source, Writer &writer, Image::Format format) {
+  switch (format) {
+  case Image::Format::RAW:
+    decodeRaw(source, writer);
+    break;
+  case Image::Format::RLE:
+    decodeRLE(source, writer);
+    break;
+  case Image::Format::QOI:
+    decodeQOI(source, writer);
+    break;
+  }
+}
+} // namespace
+
+bool Image::parse(const uint8_t *data, uint32_t length, Header &header) {
+  if (length < sizeof(Header))
+    return false;
+  memcpy(&header, data, sizeof(Header));
+  return valid(header) && header.size <= length - sizeof(Header);
+}
+
+bool Image::decode(const Text::Canvas &canvas, int16_t x, int16_t y, const uint8_t *data) {
+  Header header;
+  memcpy(&header, data, sizeof(Header));
+  if (!valid(header))
+    return false;
+
+  Source source = {data + sizeof(Header), data + sizeof(Header) + header.size, 0, endOfMemory};
+  Writer writer(canvas, x, y, header);
+  decodeStream(source, writer, header.format);
+  return true;
+}
+
+bool Image::draw(int16_t x, int16_t y, const uint8_t *data) {
+  Header header;
+  memcpy(&header, data, sizeof(Header));
+  if (!valid(header))
+    return false;
+
+#if ENABLE_LCD_TILES
+  Tiles::sprite(x, y, header.width, header.height, data);
+#else
+  Text::Canvas canvas = {LCD::framebuffer, LCD::WIDTH, 0, 0, LCD::WIDTH, LCD::HEIGHT};
+  decode(canvas, x, y, data);
+#endif
+  LCD::invalidate(x, y, header.width, header.height);
+  return true;
+}
+
+#if ENABLE_MICROSD && ENABLE_FATFS
+namespace {
+// One file is open at a time, the FIL and the chunk are too big for a task stack
+FIL file;
+#if !ENABLE_LCD_TILES
+__attribute__((section(".axi_sram"), aligned(32))) uint8_t chunk[Image::CHUNK_SIZE];
+
+bool refillFile(Source &source) {
+  if (source.left == 0)
+    return false;
+  UINT read = 0;
+  UINT wanted = source.left < Image::CHUNK_SIZE ? source.left : Image::CHUNK_SIZE;
+  if (FatFs::readFile(&file, chunk, wanted, &read) != FR_OK || read == 0)
+    return false;
+  source.pos = chunk;
+  source.end = chunk + read;
+  source.left -= read;
+  return true;
+}
+#endif
+} // namespace
+
+FRESULT Image::load(const char *path, uint8_t *buffer, uint32_t size, uint32_t *length) {
+  FRESULT res = FatFs::openFile(path, &file, FA_READ);
+  if (res != FR_OK)
+    return res;
+
+  UINT read = 0;
+  res = FatFs::readFile(&file, buffer, size, &read);
+  FatFs::closeFile(&file);
+  *length = read;
+  return res;
+}
+
+#if !ENABLE_LCD_TILES
+FRESULT Image::drawFile(const char *path, int16_t x, int16_t y) {
+  FRESULT res = FatFs::openFile(path, &file, FA_READ);
+  if (res != FR_OK)
+    return res;
+
+  Header header;
+  UINT read = 0;
+  res = FatFs::readFile(&file, &header, sizeof(header), &read);
+  if (res == FR_OK && (read != sizeof(header) || !valid(header)))
+    res = FR_INVALID_OBJECT;
+  if (res != FR_OK) {
+    FatFs::closeFile(&file);
+    return res;
+  }
+
+  Source source = {chunk, chunk, header.size, refillFile};
+  Text::Canvas canvas = {LCD::framebuffer, LCD::WIDTH, 0, 0, LCD::WIDTH, LCD::HEIGHT};
+  Writer writer(canvas, x, y, header);
+  decodeStream(source, writer, header.format);
+  FatFs::closeFile(&file);
+  LCD::invalidate(x, y, header.width, header.height);
+  return FR_OK;
+}
+#endif
+#endif
+
+#endif
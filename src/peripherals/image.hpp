@@ -0,0 +1,72 @@
+#pragma once
+
+#if ENABLE_LCD
+
+#include "../system/tcm.hpp"
+#include "text.hpp"
+
+#include <cstdint>
+
+#if ENABLE_MICROSD && ENABLE_FATFS
+#include "../middleware/FatFs/fatfs.hpp"
+#endif
+
+// Compressed RGB565 images, converted from PNG by scripts/image_convert.py
+//
+// A file is a 16 byte header followed by the pixel stream, rows top to bottom. The
+// decoder writes pixels straight into a canvas as they come out of the stream, there is
+// no decode buffer: files are read through one CHUNK_SIZE buffer, images in memory are
+// read in place. Pixels outside the canvas are dropped, decoding stops below its last
+// row. Sprites name a key colour that is not drawn.
+//
+// RLE: a control byte c < 0x80 is followed by c + 1 literal pixels, c >= 0x80 by one
+// pixel repeated (c & 0x7F) + 1 times. Pixels are little endian uint16_t.
+//
+// QOI: the QOI operations on 5/6/5 bit channels, previous pixel starts at 0 and the
+// 64 entry index hashes (r * 3 + g * 5 + b * 7) & 63.
+//   00iiiiii           pixel from the index
+//   01rrggbb           channel differences -2..1 to the previous pixel, biased by 2
+//   10gggggg rrrrbbbb  green -32..31 biased by 32, red and blue -8..7 relative to it
+//   11nnnnnn           previous pixel n + 1 times (1..62)
+//   0xFE pixel         literal pixel, little endian
+// Differences wrap within their channel. Runs and index hits do not update the index.
+namespace Image {
+constexpr uint32_t CHUNK_SIZE = 2048; // bytes read from the file at a time
+constexpr char MAGIC[4] = {'I', '5', '6', '5'};
+
+enum class Format : uint8_t { RAW, RLE, QOI };
+
+constexpr uint8_t FLAG_TRANSPARENT = 0x01; // pixels equal to key are not drawn
+
+struct Header {
+  char magic[4];
+  uint16_t width;
+  uint16_t height;
+  Format format;
+  uint8_t flags;
+  uint16_t key;
+  uint32_t size; // bytes of pixel stream after the header
+} __attribute__((packed));
+
+static_assert(sizeof(Header) == 16, "the header layout is shared with image_convert.py");
+
+// Checks the header of an image in memory, length counts the header and the stream
+bool parse(const uint8_t *data, uint32_t length, Header &header);
+// Decodes an image in memory into the canvas with its top left corner at x, y (canvas
+// coordinates like Text::draw), returns false if data is not a valid image
+bool decode(const Text::Canvas &canvas, int16_t x, int16_t y, const uint8_t *data);
+// Draws an image in memory on the LCD. With ENABLE_LCD_TILES it is decoded again for
+// every band it covers during the next update() and has to stay valid until then.
+bool draw(int16_t x, int16_t y, const uint8_t *data);
+
+#if ENABLE_MICROSD && ENABLE_FATFS
+// Reads the compressed file into buffer, length receives its size
+FRESULT load(const char *path, uint8_t *buffer, uint32_t size, uint32_t *length);
+#if !ENABLE_LCD_TILES
+// Streams the file into the framebuffer, FR_INVALID_OBJECT if it is not a valid image
+FRESULT drawFile(const char *path, int16_t x, int16_t y);
+#endif
+#endif
+} // namespace Image
+
+#endif
@@ -1,58 +1,105 @@
 #include "lcd.hpp"
 
+#include "../system/cycles.hpp"
+#include "blitter.hpp"
+#include "tiles.hpp"
+
+#include <cstring>
+
 #if ENABLE_LCD
 namespace LCD {
 // Static member initialization
-uint8_t lcd_data[16];
-// Framebuffer in .axi_sram section aligned to 32 bytes for DMA transfer
-__attribute__((section(".axi_sram"), aligned(32))) uint8_t framebuffer[FRAMEBUFFER_SIZE];
-bool dma_busy = false;
+uint8_t lcd_data[MAX_PARAMETERS];
+#if ENABLE_LCD_TILES
+// Bands of the frame, one is rendered while the other is sent
+__attribute__((section(".axi_sram"), aligned(32))) uint16_t tiles[2][WIDTH * TILE_ROWS];
+#else
+// Framebuffers in .axi_sram section aligned to 32 bytes for DMA transfer
+__attribute__((section(".axi_sram"), aligned(32))) uint16_t framebuffers[FRAMEBUFFER_COUNT][PIXEL_COUNT];
+uint16_t *framebuffer = framebuffers[0];
+// Partial-width windows are packed here, one half is filled while the other is sent
+__attribute__((section(".axi_sram"), aligned(32))) uint16_t staging[2][STAGING_SIZE / 2];
+#endif
+// Shares SPI4 at normal priority, the panel reads back on the MOSI line (3-wire)
+SPI::Device device = {LCD_CS_GPIO_Port, LCD_CS_Pin, LCD_WR_RS_GPIO_Port, LCD_WR_RS_Pin, SPI_DIRECTION_1LINE,
+                      SPI_POLARITY_LOW, SPI_PHASE_1EDGE, SPI_BAUDRATEPRESCALER_2, SPI::Priority::NORMAL};
+uint32_t frameCount = 0; // frames handed to the SPI DMA
+uint32_t bytesSent = 0;
+volatile uint32_t sentCycles = 0;
+Rect dirty[MAX_DIRTY_RECTS];
+uint8_t dirtyCount = 0;
 } // namespace LCD
 
-void LCD::writeReg(uint8_t reg, uint8_t *data, uint8_t length) {
-  waitForDMA();
-  LCD_CS_RESET;
-  LCD_RS_RESET;
-  HAL_SPI_Transmit(SPI_Drv, &reg, 1, 100);
-  LCD_RS_SET;
-  if (length > 0) {
-    HAL_SPI_Transmit(SPI_Drv, data, length, 500);
+static_assert(LCD::STAGING_SIZE >= LCD::WIDTH * 2, "a staging half must hold at least one row");
+
+static inline uint32_t area(const LCD::Rect &rect) { return rect.width * rect.height; }
+
+#if !ENABLE_LCD_TILES
+static LCD::Rect unite(const LCD::Rect &a, const LCD::Rect &b) {
+  uint8_t x = a.x < b.x ? a.x : b.x;
+  uint8_t y = a.y < b.y ? a.y : b.y;
+  uint8_t right = a.x + a.width > b.x + b.width ? a.x + a.width : b.x + b.width;
+  uint8_t bottom = a.y + a.height > b.y + b.height ? a.y + a.height : b.y + b.height;
+  return {x, y, (uint8_t)(right - x), (uint8_t)(bottom - y)};
+}
+#endif
+
+namespace {
+// Transfers of one register write, the parameters are split into inline sized chunks.
+// Returns how many steps it filled.
+uint8_t command(SPI::Transfer *steps, const uint8_t *reg, const uint8_t *data, uint8_t length) {
+  uint8_t count = 0;
+  steps[count] = SPI::Transfer();
+  steps[count].tx = reg;
+  steps[count].count = 1;
+  steps[count++].command = true;
+  for (uint8_t offset = 0; offset < length; offset += SPI::INLINE_BYTES) {
+    steps[count] = SPI::Transfer();
+    steps[count].tx = data + offset;
+    steps[count++].count = length - offset < SPI::INLINE_BYTES ? length - offset : SPI::INLINE_BYTES;
   }
-  LCD_CS_SET;
+  return count;
+}
+} // namespace
+
+void LCD::writeReg(uint8_t reg, uint8_t *data, uint8_t length) {
+  if (length > MAX_PARAMETERS)
+    length = MAX_PARAMETERS;
+  SPI::Transfer steps[1 + MAX_PARAMETERS / SPI::INLINE_BYTES];
+  SPI::submit(device, steps, command(steps, &reg, data, length));
 }
 
 void LCD::readReg(uint8_t reg, uint8_t *data) {
-  waitForDMA();
-  LCD_CS_RESET;
-  LCD_RS_RESET;
-  HAL_SPI_Transmit(SPI_Drv, &reg, 1, 100);
-  LCD_RS_SET;
-  HAL_SPI_Receive(SPI_Drv, data, 1, 500);
-  LCD_CS_SET;
+  // The panel answers on the MOSI line after the command, in the same transaction
+  SPI::Transfer steps[2];
+  command(steps, &reg, nullptr, 0);
+  steps[1].rx = data;
+  steps[1].count = 1;
+  SPI::submit(device, steps, 2);
+  SPI::wait(device);
 }
 
 void LCD::sendData(uint8_t *data, uint8_t length) {
-  waitForDMA();
-  LCD_CS_RESET;
-  HAL_SPI_Transmit(SPI_Drv, data, length, 500);
-  LCD_CS_SET;
+  for (uint8_t offset = 0; offset < length; offset += SPI::INLINE_BYTES) {
+    SPI::Transfer step;
+    step.tx = data + offset;
+    step.count = length - offset < SPI::INLINE_BYTES ? length - offset : SPI::INLINE_BYTES;
+    SPI::submit(device, &step, 1);
+  }
 }
 
 void LCD::recvData(uint8_t *data, uint8_t length) {
-  waitForDMA();
-  LCD_CS_RESET;
-  HAL_SPI_Receive(SPI_Drv, data, length, 500);
-  LCD_CS_SET;
+  SPI::Transfer step;
+  step.rx = data;
+  step.count = length;
+  SPI::submit(device, &step, 1);
+  SPI::wait(device);
 }
 
-void LCD::waitForDMA() {
-  while (dma_busy) {
-    Scheduler::yield();
-  }
-}
+void LCD::waitForDMA() { SPI::wait(device); }
 
 void LCD::init() {
-  // Initialize CS and RS pins
+  // Initialize CS and RS pins, the bus drives them from here on
   LCD_CS_SET;
   LCD_RS_SET;
   Scheduler::yieldDelay(100);
@@ -137,11 +184,13 @@ void LCD::init() {
   writeReg(ST7735_DISPLAY_ON, lcd_data, 1);
   Scheduler::yieldDelay(150);
 
-  // Clear framebuffer
-  for (uint16_t i = 0; i < FRAMEBUFFER_SIZE; i += 2) {
-    framebuffer[i] = 0x00;
-    framebuffer[i + 1] = 0x00;
-  }
+  // Clear framebuffers, the panel content is unknown so the first update sends all of it
+#if ENABLE_LCD_TILES
+  Tiles::clear();
+#else
+  memset(framebuffers, 0, sizeof(framebuffers));
+#endif
+  invalidateAll();
 }
 
 void LCD::setDisplayWindow(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
@@ -207,182 +256,317 @@ void LCD::setCursor(uint8_t x, uint8_t y) {
   writeReg(ST7735_WRITE_RAM, nullptr, 0);
 }
 
-void LCD::fillRGBRect(uint8_t x, uint8_t y, uint8_t *data, uint8_t width, uint8_t height) {
+void LCD::fillRGBRect(uint8_t x, uint8_t y, const uint16_t *data, uint8_t width, uint8_t height) {
   // Strict bounds checking
   if (x >= WIDTH || y >= HEIGHT || width == 0 || height == 0)
     return;
+
+#if ENABLE_LCD_TILES
+  // Clipped while rendering, the image rows keep their full width as stride
+  Tiles::image(x, y, width, height, data);
+  invalidate(x, y, width, height);
+#else
   if (x + width > WIDTH)
     width = WIDTH - x;
   if (y + height > HEIGHT)
     height = HEIGHT - y;
 
+  // Only the pixels that actually change are marked, so redrawing identical text is free
+  uint8_t left = WIDTH, right = 0, top = HEIGHT, bottom = 0;
   for (uint8_t row = 0; row < height; row++) {
+    uint16_t *dst = framebuffer + (y + row) * WIDTH + x;
     for (uint8_t col = 0; col < width; col++) {
-      uint16_t pixel = ((uint16_t *)data)[row * width + col];
-      uint16_t fb_index = ((y + row) * WIDTH + (x + col)) * 2;
-      if (fb_index + 1 < FRAMEBUFFER_SIZE) { // Ensure we don't write past framebuffer
-        framebuffer[fb_index] = pixel & 0xFF;
-        framebuffer[fb_index + 1] = pixel >> 8;
-      }
+      uint16_t pixel = data[row * width + col];
+      if (dst[col] == pixel)
+        continue;
+      dst[col] = pixel;
+      left = col < left ? col : left;
+      right = col > right ? col : right;
+      top = row < top ? row : top;
+      bottom = row;
     }
   }
+  if (top <= bottom)
+    invalidate(x + left, y + top, right - left + 1, bottom - top + 1);
+#endif
 }
 
-void LCD::drawChar(int16_t x, int16_t y, char c, uint8_t size) {
-  const uint8_t font_width = (size == 12 ? 6 : 8);
-  const uint8_t font_height = size;
-  uint16_t write[font_height][font_width];
-  uint8_t temp;
-  int16_t y0 = y;
-  int16_t x0 = x;
-
-  // Check if character is completely off screen
-  if (y0 >= HEIGHT || x0 >= WIDTH || y0 <= -font_height || x0 <= -font_width)
-    return;
-
-  // Calculate visible portion of character
-  uint8_t visible_width = font_width;
-  uint8_t visible_height = font_height;
-  uint8_t x_offset = 0;
-  uint8_t y_offset = 0;
-
-  // Handle horizontal clipping
-  if (x0 < 0) {
-    x_offset = -x0;
-    visible_width = font_width - x_offset;
-    x0 = 0;
-  }
-  if (x0 + visible_width > WIDTH) {
-    visible_width = WIDTH - x0;
-  }
-
-  // Handle vertical clipping
-  if (y0 < 0) {
-    y_offset = -y0;
-    visible_height = font_height - y_offset;
-    y0 = 0;
-  }
-  if (y0 + visible_height > HEIGHT) {
-    visible_height = HEIGHT - y0;
-  }
-
-  // Additional safety check
-  if (visible_width == 0 || visible_height == 0)
-    return;
-
-  // Initialize write array
-  for (uint8_t i = 0; i < font_height; i++) {
-    for (uint8_t j = 0; j < font_width; j++) {
-      write[i][j] = 0;
-    }
-  }
-
-  c = c - ' '; // Get offset value
-
-  // Process each byte in the font data
-  for (uint8_t t = 0; t < size; t++) {
-    if (size == 12) {
-      temp = ascii_1206[c][t];
-    } else {
-      temp = ascii_1608[c][t];
-    }
-
-    // Process each bit in the byte
-    for (uint8_t t1 = 0; t1 < 8; t1++) {
-      if (temp & 0x80) {
-        uint8_t col = t / 2;
-        uint8_t row = t1 + ((t % 2) * 8);
-        if (row < font_height && col < font_width) { // Additional bounds check
-          write[row][col] = POINT_COLOR;
-        }
-      }
-      temp <<= 1;
-    }
-  }
+void LCD::drawText(int16_t x, int16_t y, const char *str, const Text::Font &font, uint16_t fg, uint16_t bg) {
+#if ENABLE_LCD_TILES
+  Tiles::text(x, y, str, font, fg, bg);
+#else
+  Text::Canvas canvas = {framebuffer, WIDTH, 0, 0, WIDTH, HEIGHT};
+  Text::Damage damage = Text::draw(canvas, x, y, str, font, fg, bg);
+  invalidate(damage.left, damage.top, damage.right - damage.left, damage.bottom - damage.top);
+#endif
+}
 
-  // Only draw the visible portion of the character
-  fillRGBRect(x0, y0, (uint8_t *)&write[y_offset][x_offset], visible_width, visible_height);
+void LCD::drawChar(int16_t x, int16_t y, char c, uint8_t size) {
+  char str[2] = {c, '\0'};
+  drawText(x, y, str, Text::forSize(size), POINT_COLOR, BACK_COLOR);
 }
 
 void LCD::drawString(int16_t x, int16_t y, uint8_t size, char *str) {
-  while (*str != '\0') {
-    drawChar(x, y, *str, size);
-    x += (size == 12 ? 6 : 8);
-    str++;
-  }
+  drawText(x, y, str, Text::forSize(size), POINT_COLOR, BACK_COLOR);
 }
 
 void LCD::setPixel(uint8_t x, uint8_t y, uint16_t color) {
   if (x >= WIDTH || y >= HEIGHT)
     return;
 
-  uint16_t fb_index = (y * WIDTH + x) * 2;
-  framebuffer[fb_index] = color & 0xFF;
-  framebuffer[fb_index + 1] = color >> 8;
+#if ENABLE_LCD_TILES
+  Tiles::fill(x, y, 1, 1, color);
+#else
+  framebuffer[y * WIDTH + x] = color;
+#endif
+  invalidate(x, y, 1, 1);
 }
 
 void LCD::drawHLine(uint8_t x, uint8_t y, uint8_t length, uint16_t color) {
-  if ((x + length) > WIDTH)
+  if ((x + length) > WIDTH || y >= HEIGHT)
     return;
 
-  for (uint8_t i = 0; i < length; i++) {
-    setPixel(x + i, y, color);
-  }
+#if ENABLE_LCD_TILES
+  Tiles::fill(x, y, length, 1, color);
+#else
+  Blitter::fill(framebuffer + y * WIDTH + x, WIDTH, length, 1, color);
+#endif
+  invalidate(x, y, length, 1);
 }
 
 void LCD::drawVLine(uint8_t x, uint8_t y, uint8_t length, uint16_t color) {
-  if ((y + length) > HEIGHT)
+  if ((y + length) > HEIGHT || x >= WIDTH)
     return;
 
-  for (uint8_t i = 0; i < length; i++) {
-    setPixel(x, y + i, color);
-  }
+#if ENABLE_LCD_TILES
+  Tiles::fill(x, y, 1, length, color);
+#else
+  Blitter::fill(framebuffer + y * WIDTH + x, WIDTH, 1, length, color);
+#endif
+  invalidate(x, y, 1, length);
 }
 
 void LCD::fillRect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint16_t color) {
   if ((x + width) > WIDTH || (y + height) > HEIGHT)
     return;
 
-  for (uint8_t row = 0; row < height; row++) {
-    for (uint8_t col = 0; col < width; col++) {
-      setPixel(x + col, y + row, color);
-    }
-  }
+#if ENABLE_LCD_TILES
+  Tiles::fill(x, y, width, height, color);
+#else
+  Blitter::fill(framebuffer + y * WIDTH + x, WIDTH, width, height, color);
+#endif
+  invalidate(x, y, width, height);
 }
 
-void LCD::drawLine(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t color) {
-  int16_t dx = abs(x2 - x1);
-  int16_t dy = abs(y2 - y1);
-  int16_t sx = (x1 < x2) ? 1 : -1;
-  int16_t sy = (y1 < y2) ? 1 : -1;
-  int16_t err = dx - dy;
-
-  while (x1 != x2 || y1 != y2) {
-    setPixel(x1, y1, color);
-    int16_t e2 = 2 * err;
-    if (e2 > -dy) {
-      err -= dy;
-      x1 += sx;
+void LCD::drawLine(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) {
+#if ENABLE_LCD_TILES
+  Tiles::line(x1, y1, x2, y2, color);
+#else
+  Text::Canvas canvas = {framebuffer, WIDTH, 0, 0, WIDTH, HEIGHT};
+  Text::Damage damage = Lines::line(canvas, x1, y1, x2, y2, color);
+  invalidate(damage.left, damage.top, damage.right - damage.left, damage.bottom - damage.top);
+#endif
+}
+
+void LCD::drawPolyline(const Lines::Point *points, uint16_t count, uint16_t color) {
+#if ENABLE_LCD_TILES
+  // The display list keeps endpoints, not the points array
+  for (uint16_t i = 1; i < count; i++)
+    drawLine(points[i - 1].x, points[i - 1].y, points[i].x, points[i].y, color);
+  if (count == 1)
+    drawLine(points[0].x, points[0].y, points[0].x, points[0].y, color);
+#else
+  Text::Canvas canvas = {framebuffer, WIDTH, 0, 0, WIDTH, HEIGHT};
+  Text::Damage damage = Lines::polyline(canvas, points, count, color);
+  invalidate(damage.left, damage.top, damage.right - damage.left, damage.bottom - damage.top);
+#endif
+}
+
+void LCD::drawTrace(int16_t x, int16_t y, int16_t width, const uint8_t *rows, uint16_t count, uint16_t color) {
+#if ENABLE_LCD_TILES
+  Tiles::trace(x, y, width, rows, count, color);
+#else
+  Text::Canvas canvas = {framebuffer, WIDTH, 0, 0, WIDTH, HEIGHT};
+  Text::Damage damage = Lines::trace(canvas, x, y, width, rows, count, color);
+  invalidate(damage.left, damage.top, damage.right - damage.left, damage.bottom - damage.top);
+#endif
+}
+
+void LCD::invalidate(int16_t x, int16_t y, int16_t width, int16_t height) {
+  int16_t right = x + width;
+  int16_t bottom = y + height;
+  x = x < 0 ? 0 : x;
+  y = y < 0 ? 0 : y;
+  right = right > WIDTH ? WIDTH : right;
+  bottom = bottom > HEIGHT ? HEIGHT : bottom;
+  if (x >= right || y >= bottom)
+    return;
+
+#if ENABLE_LCD_TILES
+  // update() renders whole bands, there are no windows to merge
+  Tiles::touch(y, bottom - y);
+#else
+  Rect rect = {(uint8_t)x, (uint8_t)y, (uint8_t)(right - x), (uint8_t)(bottom - y)};
+  for (;;) {
+    // Absorb every rect that is cheaper to send together than as its own window,
+    // the union may in turn reach further rects
+    bool merged = true;
+    while (merged) {
+      merged = false;
+      for (uint8_t i = 0; i < dirtyCount; i++) {
+        Rect joined = unite(rect, dirty[i]);
+        if (area(joined) <= area(rect) + area(dirty[i]) + WINDOW_COST) {
+          rect = joined;
+          dirty[i] = dirty[--dirtyCount];
+          merged = true;
+          break;
+        }
+      }
     }
-    if (e2 < dx) {
-      err += dx;
-      y1 += sy;
+    if (dirtyCount < MAX_DIRTY_RECTS)
+      break;
+
+    // Out of slots, fold into the rect that grows least and try merging again
+    uint8_t best = 0;
+    uint32_t bestGrowth = 0xFFFFFFFF;
+    for (uint8_t i = 0; i < dirtyCount; i++) {
+      uint32_t growth = area(unite(rect, dirty[i])) - area(dirty[i]);
+      if (growth < bestGrowth) {
+        bestGrowth = growth;
+        best = i;
+      }
     }
+    rect = unite(rect, dirty[best]);
+    dirty[best] = dirty[--dirtyCount];
   }
+  dirty[dirtyCount++] = rect;
+#endif
 }
 
+void LCD::invalidateAll() {
+#if ENABLE_LCD_TILES
+  Tiles::touch(0, HEIGHT);
+#else
+  dirty[0] = {0, 0, WIDTH, HEIGHT};
+  dirtyCount = 1;
+#endif
+}
+
+// Done callback of the pixel transfers, release is the buffer's busy flag or nullptr
+ITCM_FUNC static void pixelsSent(void *release, bool) {
+  LCD::sentCycles = Cycles::now();
+  if (release)
+    *(volatile bool *)release = false;
+}
+
+// Queues the window and its pixels as one transaction, returns at once. release is
+// cleared once the pixels have left the buffer.
+static void sendWindow(const LCD::Rect &rect, const uint16_t *pixels, uint16_t count, volatile bool *release) {
+  // Calibration offsets as in setDisplayWindow
+  uint8_t x = rect.x + 1;
+  uint8_t y = rect.y + 26;
+  uint8_t columns[4] = {0, x, 0, (uint8_t)(x + rect.width - 1)};
+  uint8_t rows[4] = {0, y, 0, (uint8_t)(y + rect.height - 1)};
+  uint8_t caset = ST7735_CASET, raset = ST7735_RASET, ramwr = ST7735_WRITE_RAM;
+
+  SPI::Transfer steps[6];
+  uint8_t used = command(steps, &caset, columns, 4);
+  used += command(steps + used, &raset, rows, 4);
+  used += command(steps + used, &ramwr, nullptr, 0);
+  // One 16 bit frame per pixel, MSB first puts RGB565 on the wire in the order the
+  // panel expects without swapping bytes
+  SPI::Transfer &data = steps[used++];
+  data = SPI::Transfer();
+  data.tx = pixels;
+  data.count = count;
+  data.wide = true;
+  data.done = pixelsSent;
+  data.context = (void *)release;
+  if (release)
+    *release = true;
+  SPI::submit(LCD::device, steps, used);
+  LCD::bytesSent += count * 2;
+}
+
+// Staging halves and tile bands still queued for the DMA
+static volatile bool halfBusy[2] = {false, false};
+
+static void claim(uint8_t half) {
+  while (halfBusy[half])
+    Scheduler::yield();
+}
+
+#if ENABLE_LCD_TILES
+void LCD::update() {
+  if (Tiles::changed == 0)
+    return;
+
+  // Alternates across updates too, the last band of a frame may still be on the bus.
+  // A band renders as soon as the DMA has left it, while the other one is sent.
+  static uint8_t half = 0;
+  for (uint8_t y = 0; y < HEIGHT; y += TILE_ROWS) {
+    if (!(Tiles::changed & 1u << (y / TILE_ROWS)))
+      continue;
+    uint8_t rows = HEIGHT - y < TILE_ROWS ? HEIGHT - y : TILE_ROWS;
+    claim(half);
+    Tiles::render(tiles[half], WIDTH, y, rows);
+    sendWindow({0, y, WIDTH, rows}, tiles[half], WIDTH * rows, &halfBusy[half]);
+    half ^= 1;
+  }
+
+  // The list stays, the next frame only changes what it draws again
+  Tiles::changed = 0;
+  frameCount++;
+}
+#else
 void LCD::update() {
+  if (dirtyCount == 0)
+    return;
+
+  uint16_t *front = framebuffer;
+#if ENABLE_LCD_DOUBLE_BUFFER
+  // The buffer about to become the back buffer may still be queued
   waitForDMA();
+  framebuffer = front == framebuffers[0] ? framebuffers[1] : framebuffers[0];
+#endif
+
+  // Alternates across updates too, the last transfer of a frame may still be reading its half
+  static uint8_t half = 0;
+  for (uint8_t i = 0; i < dirtyCount; i++) {
+    const Rect &rect = dirty[i];
+    if (rect.width == WIDTH) {
+      // Full rows are contiguous in the framebuffer and go out in place
+      sendWindow(rect, &front[rect.y * WIDTH], area(rect), nullptr);
+      continue;
+    }
 
-  setDisplayWindow(0, 0, WIDTH, HEIGHT);
-  writeReg(ST7735_WRITE_RAM, nullptr, 0);
+    // Pack rows into a staging half while the queue still sends the other one. A half
+    // holds more rows of a narrow window than uint8_t counts, never more than the screen.
+    uint16_t fit = STAGING_SIZE / 2 / rect.width;
+    uint8_t rowsPerChunk = fit < HEIGHT ? fit : HEIGHT;
+    for (uint8_t row = 0; row < rect.height; row += rowsPerChunk) {
+      uint8_t rows = rect.height - row < rowsPerChunk ? rect.height - row : rowsPerChunk;
+      claim(half);
+      Blitter::copy(staging[half], rect.width, front + (rect.y + row) * WIDTH + rect.x, WIDTH, rect.width, rows);
+      sendWindow({rect.x, (uint8_t)(rect.y + row), rect.width, rows}, staging[half], rows * rect.width,
+                 &halfBusy[half]);
+      half ^= 1;
+    }
+  }
 
-  static_assert(FRAMEBUFFER_SIZE % 32 == 0, "FRAMEBUFFER_SIZE must be a multiple of 32");
-  SCB_InvalidateDCache_by_Addr(framebuffer, FRAMEBUFFER_SIZE);
+#if ENABLE_LCD_DOUBLE_BUFFER
+  // Bring the back buffer up to date with what was just drawn, the DMA only reads the
+  // front buffer so both can run at once. Drawing then continues from the shown frame.
+  for (uint8_t i = 0; i < dirtyCount; i++) {
+    const Rect &rect = dirty[i];
+    uint32_t offset = rect.y * WIDTH + rect.x;
+    Blitter::copy(framebuffer + offset, WIDTH, front + offset, WIDTH, rect.width, rect.height);
+  }
+#endif
 
-  LCD_CS_RESET;
-  dma_busy = true;
-  HAL_SPI_Transmit_DMA(SPI_Drv, framebuffer, FRAMEBUFFER_SIZE);
+  dirtyCount = 0;
+  frameCount++;
 }
+#endif
 
 #endif
\ No newline at end of file
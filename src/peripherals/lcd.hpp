@@ -2,12 +2,26 @@
 
 #if ENABLE_LCD
 
+#ifndef ENABLE_LCD_DOUBLE_BUFFER
+#define ENABLE_LCD_DOUBLE_BUFFER 0
+#endif
+
+#ifndef ENABLE_LCD_TILES
+#define ENABLE_LCD_TILES 0
+#endif
+
+#if ENABLE_LCD_TILES && ENABLE_LCD_DOUBLE_BUFFER
+#error "ENABLE_LCD_TILES has no framebuffer to double buffer, turn off ENABLE_LCD_DOUBLE_BUFFER"
+#endif
+
 #include "../system/scheduler.hpp"
-#include "font.hpp"
+#include "../system/tcm.hpp"
 #include "gpio.hpp"
+#include "lines.hpp"
 #include "spi.hpp"
 #include "stm32h7xx.h"
 #include "stm32h7xx_hal.h"
+#include "text.hpp"
 #include "timer.hpp"
 
 #include <stdio.h>
@@ -19,7 +33,6 @@
 #define LCD_CS_RESET HAL_GPIO_WritePin(LCD_CS_GPIO_Port, LCD_CS_Pin, GPIO_PIN_RESET)
 
 // Hardware Configuration
-#define SPI_Drv                (&SPI::hspi4)
 #define LCD_Brightness_timer   &Timer::htim1
 #define LCD_Brightness_channel TIM_CHANNEL_2
 
@@ -104,6 +117,24 @@ namespace LCD {
 constexpr uint8_t HEIGHT = 80;
 constexpr uint8_t WIDTH = 160;
 
+// Dirty rectangle tracking, update() only sends the windows the drawing functions touched
+constexpr uint8_t MAX_DIRTY_RECTS = 8;
+// Pixels a separate window costs on the bus (CASET, RASET, RAMWR), cheaper merges are taken
+constexpr uint16_t WINDOW_COST = 64;
+// Each half of the buffer that packs partial-width windows for the DMA
+constexpr uint16_t STAGING_SIZE = 2048;
+// Rows per band with ENABLE_LCD_TILES, one band renders while the other is sent
+constexpr uint8_t TILE_ROWS = 4;
+// Longest parameter list of a register write, lcd_data holds that many
+constexpr uint8_t MAX_PARAMETERS = 16;
+
+struct Rect {
+  uint8_t x;
+  uint8_t y;
+  uint8_t width;
+  uint8_t height;
+};
+
 // Display control
 void init();
 void displayOn();
@@ -112,37 +143,74 @@ void setBrightness(uint32_t brightness);
 uint32_t getBrightness();
 void readID(uint32_t *id);
 
-// Drawing functions
+// Drawing functions, the pixel loops run from ITCM
 void setCursor(uint8_t x, uint8_t y);
-void setPixel(uint8_t x, uint8_t y, uint16_t color);
-void drawHLine(uint8_t x, uint8_t y, uint8_t length, uint16_t color);
-void drawVLine(uint8_t x, uint8_t y, uint8_t length, uint16_t color);
-void drawLine(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t color);
-void fillRect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint16_t color);
+ITCM_FUNC void setPixel(uint8_t x, uint8_t y, uint16_t color);
+ITCM_FUNC void drawHLine(uint8_t x, uint8_t y, uint8_t length, uint16_t color);
+ITCM_FUNC void drawVLine(uint8_t x, uint8_t y, uint8_t length, uint16_t color);
+// Lines are clipped to the screen, both end points are drawn
+void drawLine(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+void drawPolyline(const Lines::Point *points, uint16_t count, uint16_t color);
+// Oscilloscope trace, count samples spread over width columns, each sample a row below
+// y. With ENABLE_LCD_TILES rows is read during the next update() and has to stay valid.
+void drawTrace(int16_t x, int16_t y, int16_t width, const uint8_t *rows, uint16_t count, uint16_t color);
+ITCM_FUNC void fillRect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint16_t color);
+// Text in POINT_COLOR on BACK_COLOR, size 12 or 16
 void drawChar(int16_t x, int16_t y, char c, uint8_t size);
 void drawString(int16_t x, int16_t y, uint8_t size, char *str);
+// Only pixels that change are written and marked dirty, redrawing the same text is free
+void drawText(int16_t x, int16_t y, const char *str, const Text::Font &font, uint16_t fg, uint16_t bg);
+// Queues the dirty windows, returns without touching the bus if nothing changed. With
+// ENABLE_LCD_DOUBLE_BUFFER it first waits for the previous frame, swaps the buffers and
+// returns while the new front buffer is sent. With ENABLE_LCD_TILES it renders the
+// display list, which stays across frames, into the bands whose commands changed and
+// sends only those.
 void update();
+// Marks an area for the next update, for code writing the framebuffer directly
+void invalidate(int16_t x, int16_t y, int16_t width, int16_t height);
+void invalidateAll();
 
-// DMA status
-extern bool dma_busy;
+// Bus and DMA status, SPI::getStats() has the queue and error counters
+extern SPI::Device device;
+extern uint32_t frameCount;
+extern uint32_t bytesSent; // pixel data handed to the SPI DMA
+extern volatile uint32_t sentCycles; // cycle counter when the last pixel transfer finished
+extern Rect dirty[MAX_DIRTY_RECTS];
+extern uint8_t dirtyCount;
 
 // Constants
 constexpr uint16_t POINT_COLOR = 0xFFFF;
 constexpr uint16_t BACK_COLOR = 0x0000;
-constexpr uint16_t FRAMEBUFFER_SIZE = WIDTH * HEIGHT * 2; // 2 bytes per pixel
+constexpr uint16_t PIXEL_COUNT = WIDTH * HEIGHT;
+constexpr uint16_t FRAMEBUFFER_SIZE = PIXEL_COUNT * 2; // bytes, native RGB565 pixels
+// With double buffering update() swaps, drawing continues in the back buffer while the
+// front buffer is sent
+constexpr uint8_t FRAMEBUFFER_COUNT = ENABLE_LCD_DOUBLE_BUFFER ? 2 : 1;
 
 // Buffers
-extern uint8_t lcd_data[16];
-extern uint8_t framebuffer[FRAMEBUFFER_SIZE];
+extern uint8_t lcd_data[MAX_PARAMETERS];
+#if ENABLE_LCD_TILES
+// Drawing functions record into Tiles, there is no framebuffer
+extern uint16_t tiles[2][WIDTH * TILE_ROWS];
+#else
+extern uint16_t framebuffers[FRAMEBUFFER_COUNT][PIXEL_COUNT];
+extern uint16_t *framebuffer; // the buffer drawing functions write to
+extern uint16_t staging[2][STAGING_SIZE / 2];
+#endif
 
-// Low-level functions
+// Low-level functions. Writes are queued on the SPI bus as transactions and return at
+// once, the bus sends them in order and drives CS and RS. Reads wait for their answer.
 void writeReg(uint8_t reg, uint8_t *data, uint8_t length);
 void readReg(uint8_t reg, uint8_t *data);
 void sendData(uint8_t *data, uint8_t length);
 void recvData(uint8_t *data, uint8_t length);
+// Waits until everything queued is on the panel
 void waitForDMA();
 void setDisplayWindow(uint8_t x, uint8_t y, uint8_t width, uint8_t height);
-void fillRGBRect(uint8_t x, uint8_t y, uint8_t *data, uint8_t width, uint8_t height);
+// data holds width * height native RGB565 pixels like the framebuffer, not the low/high
+// byte pairs of old, they go out as 16 bit SPI frames. With ENABLE_LCD_TILES data is
+// read during the next update() and has to stay valid.
+ITCM_FUNC void fillRGBRect(uint8_t x, uint8_t y, const uint16_t *data, uint8_t width, uint8_t height);
 } // namespace LCD
 
 #endif
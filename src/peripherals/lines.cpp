@@ -0,0 +1,185 @@
+#include "lines.hpp"
+
+#if ENABLE_LCD
+
+namespace {
+enum : uint8_t { INSIDE = 0, LEFT = 1, RIGHT = 2, ABOVE = 4, BELOW = 8 };
+
+// Cohen-Sutherland region of a point relative to the canvas
+inline uint8_t outcode(const Text::Canvas &canvas, int32_t x, int32_t y) {
+  uint8_t code = INSIDE;
+  if (x < canvas.x)
+    code |= LEFT;
+  else if (x >= canvas.x + canvas.width)
+    code |= RIGHT;
+  if (y < canvas.y)
+    code |= ABOVE;
+  else if (y >= canvas.y + canvas.height)
+    code |= BELOW;
+  return code;
+}
+
+// Step i of a walk lands minor offset floor((2 * i * minor + major) / (2 * major)) from
+// its start, this is the first step that reaches offset j
+inline int32_t firstStep(int32_t j, int32_t major, int32_t minor) {
+  if (j <= 0)
+    return 0;
+  if (minor == 0)
+    return major + 1; // never
+  int64_t distance = (int64_t)(2 * j - 1) * major;
+  return (distance + 2 * minor - 1) / (2 * minor);
+}
+
+inline void grow(Text::Damage &damage, int32_t left, int32_t top, int32_t right, int32_t bottom) {
+  damage.left = left < damage.left ? left : damage.left;
+  damage.top = top < damage.top ? top : damage.top;
+  damage.right = right > damage.right ? right : damage.right;
+  damage.bottom = bottom > damage.bottom ? bottom : damage.bottom;
+}
+
+// Last sample of a column, each column covers at least one
+inline uint32_t columnEnd(int32_t column, uint16_t count, int16_t width) {
+  uint32_t end = (uint32_t)(column + 1) * count / width;
+  uint32_t first = (uint32_t)column * count / width;
+  return end > first ? end : first + 1;
+}
+} // namespace
+
+Text::Damage Lines::line(const Text::Canvas &canvas, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color,
+                         bool last) {
+  Text::Damage damage = {INT16_MAX, INT16_MAX, INT16_MIN, INT16_MIN};
+  uint8_t code1 = outcode(canvas, x1, y1);
+  uint8_t code2 = outcode(canvas, x2, y2);
+  // Both ends beyond the same edge
+  if (code1 & code2)
+    return damage;
+
+  // Walk the major axis upwards from step first to step end, the minor one either way
+  int32_t dx = x2 > x1 ? x2 - x1 : x1 - x2;
+  int32_t dy = y2 > y1 ? y2 - y1 : y1 - y2;
+  bool steep = dy > dx;
+  int32_t m1 = steep ? y1 : x1, n1 = steep ? x1 : y1;
+  int32_t m2 = steep ? y2 : x2, n2 = steep ? x2 : y2;
+  bool reversed = m1 > m2;
+  if (reversed) {
+    int32_t m = m1, n = n1;
+    m1 = m2, n1 = n2;
+    m2 = m, n2 = n;
+  }
+  int32_t major = m2 - m1;
+  int32_t minor = n2 > n1 ? n2 - n1 : n1 - n2;
+  int32_t direction = n2 >= n1 ? 1 : -1;
+  int32_t first = !last && reversed ? 1 : 0;
+  int32_t end = !last && !reversed ? major - 1 : major;
+
+  if (major == 0) {
+    // A single point, inside since its outcode is not shared with itself
+    if (first > end)
+      return damage;
+    canvas.pixels[(y1 - canvas.y) * canvas.stride + (x1 - canvas.x)] = color;
+    grow(damage, x1, y1, x1 + 1, y1 + 1);
+    return damage;
+  }
+
+  if (code1 | code2) {
+    int32_t low = steep ? canvas.y : canvas.x;
+    int32_t high = low + (steep ? canvas.height : canvas.width) - 1;
+    int32_t sideLow = steep ? canvas.x : canvas.y;
+    int32_t sideHigh = sideLow + (steep ? canvas.width : canvas.height) - 1;
+    // Minor offsets from n1 that are on the canvas
+    int32_t jLow = direction > 0 ? sideLow - n1 : n1 - sideHigh;
+    int32_t jHigh = direction > 0 ? sideHigh - n1 : n1 - sideLow;
+
+    int32_t from = firstStep(jLow, major, minor);
+    int32_t to = firstStep(jHigh + 1, major, minor) - 1;
+    from = low - m1 > from ? low - m1 : from;
+    to = high - m1 < to ? high - m1 : to;
+    first = from > first ? from : first;
+    end = to < end ? to : end;
+  }
+  if (first > end)
+    return damage;
+
+  int64_t distance = (int64_t)2 * first * minor + major;
+  int32_t j = distance / (2 * major);
+  int32_t err = distance % (2 * major);
+  int32_t x = steep ? n1 + direction * j : m1 + first;
+  int32_t y = steep ? m1 + first : n1 + direction * j;
+  int32_t stepMajor = steep ? canvas.stride : 1;
+  int32_t stepMinor = steep ? direction : direction * canvas.stride;
+  uint16_t *pixel = canvas.pixels + (y - canvas.y) * canvas.stride + (x - canvas.x);
+
+  // Runs of pixels on one minor coordinate, spans along the major axis
+  int32_t count = end - first + 1;
+  while (count > 0) {
+    int32_t run = minor == 0 ? count : (2 * major - err + 2 * minor - 1) / (2 * minor);
+    run = run < count ? run : count;
+    for (int32_t i = 0; i < run; i++) {
+      *pixel = color;
+      pixel += stepMajor;
+    }
+    count -= run;
+    err += run * 2 * minor - 2 * major;
+    pixel += stepMinor;
+  }
+
+  // The walk is monotonic in both axes, its ends bound it
+  int32_t jEnd = ((int64_t)2 * end * minor + major) / (2 * major);
+  int32_t xEnd = steep ? n1 + direction * jEnd : m1 + end;
+  int32_t yEnd = steep ? m1 + end : n1 + direction * jEnd;
+  grow(damage, x < xEnd ? x : xEnd, y < yEnd ? y : yEnd, (x > xEnd ? x : xEnd) + 1, (y > yEnd ? y : yEnd) + 1);
+  return damage;
+}
+
+Text::Damage Lines::polyline(const Text::Canvas &canvas, const Point *points, uint16_t count, uint16_t color) {
+  if (count == 1)
+    return line(canvas, points[0].x, points[0].y, points[0].x, points[0].y, color);
+
+  Text::Damage damage = {INT16_MAX, INT16_MAX, INT16_MIN, INT16_MIN};
+  for (uint16_t i = 1; i < count; i++) {
+    Text::Damage segment =
+        line(canvas, points[i - 1].x, points[i - 1].y, points[i].x, points[i].y, color, i == count - 1);
+    if (segment.left < segment.right)
+      grow(damage, segment.left, segment.top, segment.right, segment.bottom);
+  }
+  return damage;
+}
+
+Text::Damage Lines::trace(const Text::Canvas &canvas, int16_t x, int16_t y, int16_t width, const uint8_t *rows,
+                          uint16_t count, uint16_t color) {
+  Text::Damage damage = {INT16_MAX, INT16_MAX, INT16_MIN, INT16_MIN};
+  if (count == 0 || width <= 0)
+    return damage;
+
+  int32_t left = canvas.x > x ? canvas.x - x : 0;
+  int32_t right = canvas.x + canvas.width - x < width ? canvas.x + canvas.width - x : width;
+  int32_t top = canvas.y;
+  int32_t bottom = canvas.y + canvas.height;
+  // Sample range [first, end) of the column, the previous column ended at first
+  uint32_t first = left > 0 ? columnEnd(left - 1, count, width) : 0;
+
+  for (int32_t column = left; column < right; column++) {
+    uint32_t end = columnEnd(column, count, width);
+    uint8_t low = rows[first > 0 ? first - 1 : 0];
+    uint8_t high = low;
+    for (uint32_t i = first; i < end; i++) {
+      low = rows[i] < low ? rows[i] : low;
+      high = rows[i] > high ? rows[i] : high;
+    }
+    first = end;
+
+    int32_t from = y + low > top ? y + low : top;
+    int32_t to = y + high + 1 < bottom ? y + high + 1 : bottom;
+    if (from >= to)
+      continue;
+    uint16_t *pixel = canvas.pixels + (from - canvas.y) * canvas.stride + (x + column - canvas.x);
+    for (int32_t row = from; row < to; row++) {
+      *pixel = color;
+      pixel += canvas.stride;
+    }
+    grow(damage, x + column, from, x + column + 1, to);
+  }
+  return damage;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#if ENABLE_LCD
+
+#include "../system/tcm.hpp"
+#include "text.hpp"
+
+#include <cstdint>
+
+// Clipped lines, polylines and sample traces on an RGB565 canvas
+//
+// A line is walked along its major axis and written as runs: one vertical span per
+// column for steep lines, one horizontal span per row for flat ones. Before the walk it
+// is clipped to the canvas: Cohen-Sutherland outcodes reject lines beside it and skip
+// the clipping of lines inside it, the rest is cut to the steps that land on the canvas.
+// The cut is made on the walk itself, so a clipped line, e.g. the part in one tile band,
+// has exactly the pixels of the whole one.
+//
+// A trace spreads samples over columns, oscilloscope style. Every column is one vertical
+// span from the last sample of the previous column to the extremes of its own samples,
+// so any number of samples joins into a continuous curve at one span per column.
+namespace Lines {
+struct Point {
+  int16_t x;
+  int16_t y;
+};
+
+// Draws from (x1, y1) to (x2, y2) in screen coordinates, the end point only if last is
+// set, polylines leave it to the next segment
+ITCM_FUNC Text::Damage line(const Text::Canvas &canvas, int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                            uint16_t color, bool last = true);
+// Joins count points with lines, each one drawn once
+Text::Damage polyline(const Text::Canvas &canvas, const Point *points, uint16_t count, uint16_t color);
+// Spreads count samples over width columns starting at x, a sample is a row below y
+ITCM_FUNC Text::Damage trace(const Text::Canvas &canvas, int16_t x, int16_t y, int16_t width, const uint8_t *rows,
+                             uint16_t count, uint16_t color);
+} // namespace Lines
+
+#endif
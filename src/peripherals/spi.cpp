@@ -1,13 +1,159 @@
 #include "spi.hpp"
 
 #include "../error/handler.hpp"
-#include "lcd.hpp"
+#include "../system/cycles.hpp"
+#include "../system/scheduler.hpp"
+
+#include <cstring>
 
 namespace SPI {
 SPI_HandleTypeDef hspi4;
 DMA_HandleTypeDef hdma_spi4_tx;
+DMA_HandleTypeDef hdma_spi4_rx;
 } // namespace SPI
 
+namespace {
+struct Slot {
+  SPI::Transfer transfer;
+  SPI::Device *device;
+  bool hold; // the next slot belongs to the same transaction
+};
+
+// Tasks append whole transactions at head, the SPI interrupt consumes from tail
+struct Ring {
+  Slot slots[SPI::QUEUE_SIZE];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+};
+
+Ring rings[SPI::PRIORITY_COUNT];
+Ring *active = nullptr;          // ring of the transaction on the bus
+SPI::Device *selected = nullptr; // device whose CS is low
+volatile bool running = false;
+uint32_t busyStart = 0;
+SPI::Stats stats = {};
+
+inline uint8_t next(uint8_t index) { return index + 1 == SPI::QUEUE_SIZE ? 0 : index + 1; }
+
+inline uint8_t used(const Ring &ring) {
+  return ring.head >= ring.tail ? ring.head - ring.tail : ring.head + SPI::QUEUE_SIZE - ring.tail;
+}
+
+inline uint32_t size(const SPI::Transfer &transfer) { return transfer.count * (transfer.wide ? 2 : 1); }
+
+inline bool viaDMA(const SPI::Transfer &transfer) { return size(transfer) > SPI::INLINE_BYTES; }
+
+// The DMA moves one frame per request, its element size follows the frame size
+void setDMAWidth(DMA_HandleTypeDef &hdma, bool wide) {
+  uint32_t periph = wide ? DMA_PDATAALIGN_HALFWORD : DMA_PDATAALIGN_BYTE;
+  uint32_t memory = wide ? DMA_MDATAALIGN_HALFWORD : DMA_MDATAALIGN_BYTE;
+  if (hdma.Init.PeriphDataAlignment == periph)
+    return;
+  hdma.Init.PeriphDataAlignment = periph;
+  hdma.Init.MemDataAlignment = memory;
+  MODIFY_REG(((DMA_Stream_TypeDef *)hdma.Instance)->CR, DMA_SxCR_PSIZE | DMA_SxCR_MSIZE, periph | memory);
+}
+
+// CFG1 and CFG2 are only writable while SPE is clear, the HAL disables the SPI after
+// every transfer
+ITCM_FUNC void configure(const SPI::Device &device, bool wide) {
+  SPI_InitTypeDef &init = SPI::hspi4.Init;
+  uint32_t dataSize = wide ? SPI_DATASIZE_16BIT : SPI_DATASIZE_8BIT;
+  if (init.DataSize != dataSize || init.BaudRatePrescaler != device.prescaler) {
+    init.DataSize = dataSize;
+    init.BaudRatePrescaler = device.prescaler;
+    MODIFY_REG(SPI::hspi4.Instance->CFG1, SPI_CFG1_DSIZE | SPI_CFG1_MBR, dataSize | device.prescaler);
+    setDMAWidth(SPI::hdma_spi4_tx, wide);
+    setDMAWidth(SPI::hdma_spi4_rx, wide);
+  }
+  if (init.Direction != device.direction || init.CLKPolarity != device.polarity || init.CLKPhase != device.phase) {
+    init.Direction = device.direction;
+    init.CLKPolarity = device.polarity;
+    init.CLKPhase = device.phase;
+    MODIFY_REG(SPI::hspi4.Instance->CFG2, SPI_CFG2_COMM | SPI_CFG2_CPOL | SPI_CFG2_CPHA,
+               device.direction | device.polarity | device.phase);
+  }
+}
+
+ITCM_FUNC HAL_StatusTypeDef start(SPI::Transfer &transfer) {
+  uint8_t *tx = (uint8_t *)transfer.tx;
+  uint8_t *rx = (uint8_t *)transfer.rx;
+  if (viaDMA(transfer)) {
+    if (tx && rx)
+      return HAL_SPI_TransmitReceive_DMA(&SPI::hspi4, tx, rx, transfer.count);
+    if (rx)
+      return HAL_SPI_Receive_DMA(&SPI::hspi4, rx, transfer.count);
+    return HAL_SPI_Transmit_DMA(&SPI::hspi4, tx, transfer.count);
+  }
+  if (tx && rx)
+    return HAL_SPI_TransmitReceive_IT(&SPI::hspi4, tx, rx, transfer.count);
+  if (rx)
+    return HAL_SPI_Receive_IT(&SPI::hspi4, rx, transfer.count);
+  return HAL_SPI_Transmit_IT(&SPI::hspi4, tx, transfer.count);
+}
+
+// Retires the transfer at the tail of the active ring. A failure drops the rest of its
+// transaction, a device would misread a payload whose command never arrived.
+ITCM_FUNC void finish(bool ok) {
+  Ring &ring = *active;
+  if (!ok)
+    stats.errors++;
+  for (;;) {
+    Slot &slot = ring.slots[ring.tail];
+    SPI::Transfer &transfer = slot.transfer;
+    bool hold = slot.hold;
+    if (ok) {
+      stats.transfers++;
+      stats.bytes += size(transfer);
+      if (transfer.rx && viaDMA(transfer))
+        SCB_InvalidateDCache_by_Addr((uint32_t *)transfer.rx, size(transfer));
+    }
+    slot.device->queued--;
+    if (transfer.done)
+      transfer.done(transfer.context, ok);
+    ring.tail = next(ring.tail);
+
+    if (!hold) {
+      HAL_GPIO_WritePin(selected->csPort, selected->csPin, GPIO_PIN_SET);
+      selected = nullptr;
+      active = nullptr;
+      stats.transactions++;
+      return;
+    }
+    if (ok)
+      return;
+  }
+}
+
+// Starts the next transfer, a transaction on the bus continues before any other ring is
+// looked at. Marks the bus idle once every ring is empty.
+ITCM_FUNC void startNext() {
+  for (;;) {
+    for (uint8_t i = 0; active == nullptr && i < SPI::PRIORITY_COUNT; i++) {
+      if (rings[i].head != rings[i].tail)
+        active = &rings[i];
+    }
+    if (active == nullptr)
+      break;
+
+    Slot &slot = active->slots[active->tail];
+    SPI::Device &device = *slot.device;
+    configure(device, slot.transfer.wide);
+    if (selected == nullptr) {
+      selected = &device;
+      HAL_GPIO_WritePin(device.csPort, device.csPin, GPIO_PIN_RESET);
+    }
+    if (device.dcPort)
+      HAL_GPIO_WritePin(device.dcPort, device.dcPin, slot.transfer.command ? GPIO_PIN_RESET : GPIO_PIN_SET);
+    if (start(slot.transfer) == HAL_OK)
+      return;
+    finish(false);
+  }
+  stats.busyCycles += Cycles::since(busyStart);
+  running = false;
+}
+} // namespace
+
 void SPI::init() {
   __HAL_RCC_SPI4_CLK_ENABLE();
 
@@ -38,6 +184,8 @@ void SPI::init() {
     ErrorHandler::handle(ErrorCode::SPI_INIT_FAILED);
   }
 
+  // Only SCK and MOSI are routed, PE13 (SPI4 MISO) is the LCD's RS line. 3-wire devices
+  // receive on MOSI, a full duplex device needs MISO moved to a free pin first.
   GPIO_InitTypeDef GPIO_InitStruct = {0};
   if (hspi4.Instance == SPI4) {
     __HAL_RCC_SPI4_CLK_ENABLE();
@@ -61,13 +209,15 @@ void SPI::initDMA() {
   hdma_spi4_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
   hdma_spi4_tx.Init.PeriphInc = DMA_PINC_DISABLE;
   hdma_spi4_tx.Init.MemInc = DMA_MINC_ENABLE;
-  hdma_spi4_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
-  hdma_spi4_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  // One element per SPI frame, configure() switches between bytes and halfwords. The
+  // FIFO collects four-beat memory bursts so the AXI SRAM is read in blocks.
+  hdma_spi4_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  hdma_spi4_tx.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
   hdma_spi4_tx.Init.Mode = DMA_NORMAL;
   hdma_spi4_tx.Init.Priority = DMA_PRIORITY_HIGH;
-  hdma_spi4_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+  hdma_spi4_tx.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
   hdma_spi4_tx.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
-  hdma_spi4_tx.Init.MemBurst = DMA_MBURST_SINGLE;
+  hdma_spi4_tx.Init.MemBurst = DMA_MBURST_INC4;
   hdma_spi4_tx.Init.PeriphBurst = DMA_PBURST_SINGLE;
 
   if (HAL_DMA_Init(&hdma_spi4_tx) != HAL_OK) {
@@ -76,19 +226,117 @@ void SPI::initDMA() {
 
   __HAL_LINKDMA(&hspi4, hdmatx, hdma_spi4_tx);
 
+  hdma_spi4_rx.Instance = DMA1_Stream1;
+  hdma_spi4_rx.Init = hdma_spi4_tx.Init;
+  hdma_spi4_rx.Init.Request = DMA_REQUEST_SPI4_RX;
+  hdma_spi4_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+
+  if (HAL_DMA_Init(&hdma_spi4_rx) != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::DMA_INIT_FAILED, __FILE__, __LINE__);
+  }
+
+  __HAL_LINKDMA(&hspi4, hdmarx, hdma_spi4_rx);
+
   // Enable DMA interrupts
   __HAL_DMA_ENABLE_IT(&hdma_spi4_tx, DMA_IT_TC);
+  __HAL_DMA_ENABLE_IT(&hdma_spi4_rx, DMA_IT_TC);
 
   HAL_NVIC_SetPriority(DMA1_Stream0_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+  HAL_NVIC_SetPriority(DMA1_Stream1_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream1_IRQn);
 
   HAL_NVIC_SetPriority(SPI4_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(SPI4_IRQn);
 }
 
-void SPI::dmaTxCompleteCallback() {
-#if ENABLE_LCD
-  LCD_CS_SET; // Release CS after DMA transfer
-  LCD::dma_busy = false;
-#endif
-}
\ No newline at end of file
+void SPI::submit(Device &device, const Transfer *transfers, uint8_t count) {
+  if (count == 0 || count >= QUEUE_SIZE) {
+    ErrorHandler::handle(ErrorCode::SPI_TRANSFER_FAILED, __FILE__, __LINE__);
+    return;
+  }
+
+  // DMA sources are read from memory, so clean them. Only the first 128 KB of AXI SRAM is
+  // write-through (Init_MPU), a buffer on the stack or heap past it is write-back
+  for (uint8_t i = 0; i < count; i++) {
+    const Transfer &transfer = transfers[i];
+    if (transfer.tx && viaDMA(transfer)) {
+      uint32_t start = (uint32_t)transfer.tx & ~31u;
+      SCB_CleanDCache_by_Addr((uint32_t *)start, size(transfer) + ((uint32_t)transfer.tx - start));
+    }
+  }
+
+  Ring &ring = rings[(uint8_t)device.priority];
+  bool stalled = false;
+  for (;;) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (used(ring) + count < QUEUE_SIZE) {
+      uint8_t head = ring.head;
+      for (uint8_t i = 0; i < count; i++) {
+        Slot &slot = ring.slots[head];
+        slot.transfer = transfers[i];
+        slot.device = &device;
+        slot.hold = i + 1 < count;
+        if (slot.transfer.tx && !viaDMA(slot.transfer)) {
+          memcpy(slot.transfer.bytes, slot.transfer.tx, size(slot.transfer));
+          slot.transfer.tx = slot.transfer.bytes;
+        }
+        head = next(head);
+      }
+      device.queued += count;
+      ring.head = head;
+      uint8_t depth = used(ring);
+      uint8_t &peak = stats.peak[(uint8_t)device.priority];
+      peak = depth > peak ? depth : peak;
+      if (!running) {
+        running = true;
+        busyStart = Cycles::now();
+        startNext();
+      }
+      __set_PRIMASK(primask);
+      return;
+    }
+    __set_PRIMASK(primask);
+
+    if (!stalled) {
+      stats.stalls++;
+      stalled = true;
+    }
+    Scheduler::yield();
+  }
+}
+
+void SPI::wait(const Device &device) {
+  while (device.queued != 0) {
+    Scheduler::yield();
+  }
+}
+
+void SPI::clearFlag(void *context, bool ok) { *(volatile bool *)context = false; }
+
+SPI::Stats SPI::getStats() {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  Stats copy = stats;
+  // Count the transaction on the bus up to now, utilization over a window stays exact
+  if (running)
+    copy.busyCycles += Cycles::since(busyStart);
+  __set_PRIMASK(primask);
+  return copy;
+}
+
+void SPI::transferCompleteCallback() {
+  // Interrupt mode and DMA transfers both end here
+  if (active == nullptr)
+    return;
+  finish(true);
+  startNext();
+}
+
+void SPI::errorCallback() {
+  if (active == nullptr)
+    return;
+  finish(false);
+  startNext();
+}
@@ -1,13 +1,82 @@
 #pragma once
 
+#include "../system/tcm.hpp"
 #include "stm32h7xx.h"
 #include "stm32h7xx_hal.h"
 
+#include <cstdint>
+
+// Shared SPI4 bus
+//
+// Devices describe their chip select, optional data/command line, mode and clock. Work
+// is submitted as transactions, a list of transfers that go out back to back with CS
+// held low. Transactions are copied into one ring per priority and return at once, the
+// SPI interrupt runs them in order and picks the highest priority ring whenever the bus
+// is free, so a transaction never waits for more than the one currently on the bus.
+// Transfers of up to INLINE_BYTES are copied and sent by interrupt, larger ones run by
+// DMA straight from the caller's buffer, which has to be in DMA reachable memory and
+// stay valid until the transfer's done callback.
 namespace SPI {
+constexpr uint8_t QUEUE_SIZE = 64;   // transfers per priority ring
+constexpr uint8_t INLINE_BYTES = 8;  // larger transfers use the DMA
+constexpr uint8_t PRIORITY_COUNT = 2;
+
+enum class Priority : uint8_t { HIGH, NORMAL };
+
+struct Device {
+  GPIO_TypeDef *csPort;
+  uint16_t csPin;
+  GPIO_TypeDef *dcPort; // low during command transfers, nullptr if the device has none
+  uint16_t dcPin;
+  uint32_t direction; // SPI_DIRECTION_2LINES (full duplex) or SPI_DIRECTION_1LINE (3-wire)
+  uint32_t polarity;  // SPI_POLARITY_LOW or SPI_POLARITY_HIGH
+  uint32_t phase;     // SPI_PHASE_1EDGE or SPI_PHASE_2EDGE
+  uint32_t prescaler; // SPI_BAUDRATEPRESCALER_x of the SPI kernel clock
+  Priority priority;  // all of a device's transactions share one ring and stay in order
+  volatile uint16_t queued = 0; // transfers queued or on the bus
+};
+
+// Called from the SPI interrupt when a transfer is done, ok is false if it failed or
+// was dropped because an earlier transfer of its transaction failed
+typedef void (*Callback)(void *context, bool ok);
+
+struct Transfer {
+  const void *tx = nullptr; // nullptr receives only
+  void *rx = nullptr;       // nullptr transmits only, both run full duplex
+  uint16_t count = 0;       // frames
+  bool wide = false;        // 16 bit frames instead of 8
+  bool command = false;     // drives the data/command line low
+  Callback done = nullptr;
+  void *context = nullptr;
+  uint8_t bytes[INLINE_BYTES]; // copy of a small tx buffer, filled by submit()
+};
+
+struct Stats {
+  uint32_t transactions;
+  uint32_t transfers;
+  uint32_t bytes;
+  uint32_t errors;     // transfers the HAL refused or failed, the rest of the transaction is dropped
+  uint32_t stalls;     // submits that waited for room in their ring
+  uint32_t busyCycles; // core cycles with a transaction on the bus, wraps
+  uint8_t peak[PRIORITY_COUNT]; // most transfers queued at once per ring
+};
+
 void init();
-void dmaTxCompleteCallback();
+void initDMA();
 extern SPI_HandleTypeDef hspi4;
 extern DMA_HandleTypeDef hdma_spi4_tx;
+extern DMA_HandleTypeDef hdma_spi4_rx;
 
-void initDMA();
+// Queues a transaction of count transfers (fewer than QUEUE_SIZE), waits for ring space
+void submit(Device &device, const Transfer *transfers, uint8_t count);
+// Waits until everything queued for the device is done
+void wait(const Device &device);
+inline bool busy(const Device &device) { return device.queued != 0; }
+// Done callback that clears the volatile bool passed as context
+ITCM_FUNC void clearFlag(void *context, bool ok);
+Stats getStats();
+
+// From the HAL SPI4 completion and error callbacks
+ITCM_FUNC void transferCompleteCallback();
+void errorCallback();
 } // namespace SPI
@@ -0,0 +1,70 @@
+#include "text.hpp"
+
+#include "font.hpp"
+
+#include <cstring>
+
+namespace {
+constexpr auto ATLAS_12 = Text::buildAtlas<12, 12>(ascii_1206);
+constexpr auto ATLAS_16 = Text::buildAtlas<16, 16>(ascii_1608);
+
+static_assert(ATLAS_12[('|' - Text::FIRST_CHAR) * 12 + 5] != 0, "atlas decoding went wrong");
+} // namespace
+
+namespace Text {
+const Font FONT_12 = {6, 12, ATLAS_12.data()};
+const Font FONT_16 = {8, 16, ATLAS_16.data()};
+} // namespace Text
+
+const Text::Font &Text::forSize(uint8_t size) { return size == 12 ? FONT_12 : FONT_16; }
+
+uint16_t Text::measure(const char *str, const Font &font) { return strlen(str) * font.width; }
+
+Text::Damage Text::draw(const Canvas &canvas, int16_t x, int16_t y, const char *str, const Font &font, uint16_t fg,
+                        uint16_t bg) {
+  Damage damage = {INT16_MAX, INT16_MAX, INT16_MIN, INT16_MIN};
+
+  // Rows of the string that fall inside the canvas, the same for every glyph
+  int16_t top = y > canvas.y ? y : canvas.y;
+  int16_t bottom = y + font.height < canvas.y + canvas.height ? y + font.height : canvas.y + canvas.height;
+  int16_t clipLeft = canvas.x;
+  int16_t clipRight = canvas.x + canvas.width;
+
+  for (; top < bottom && *str != '\0' && x < clipRight; str++, x += font.width) {
+    if (x + font.width <= clipLeft)
+      continue;
+
+    uint8_t c = *str;
+    if (c < FIRST_CHAR || c >= FIRST_CHAR + GLYPH_COUNT)
+      c = '?';
+    const uint8_t *glyph = font.rows + (c - FIRST_CHAR) * font.height;
+
+    int16_t left = x > clipLeft ? x : clipLeft;
+    int16_t right = x + font.width < clipRight ? x + font.width : clipRight;
+    uint8_t skip = left - x;
+    int16_t count = right - left;
+
+    for (int16_t row = top; row < bottom; row++) {
+      uint32_t bits = glyph[row - y] << skip;
+      uint16_t *dst = canvas.pixels + (row - canvas.y) * canvas.stride + (left - canvas.x);
+      bool changed = false;
+      for (int16_t col = 0; col < count; col++, bits <<= 1) {
+        uint16_t color = (bits & 0x80) ? fg : bg;
+        if (dst[col] != color) {
+          dst[col] = color;
+          changed = true;
+        }
+      }
+      if (changed) {
+        damage.left = left < damage.left ? left : damage.left;
+        damage.right = right > damage.right ? right : damage.right;
+        damage.top = row < damage.top ? row : damage.top;
+        damage.bottom = row + 1 > damage.bottom ? row + 1 : damage.bottom;
+      }
+    }
+  }
+
+  if (damage.right <= damage.left)
+    return {0, 0, 0, 0};
+  return damage;
+}
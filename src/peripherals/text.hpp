@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../system/tcm.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Text rendering from a 1 bpp glyph atlas
+//
+// The column-major tables in font.hpp are decoded once, at compile time, into row-major
+// atlases with one byte per glyph row (MSB is the leftmost pixel). Drawing walks those
+// bytes and writes foreground or background colours straight into an RGB565 canvas,
+// only touching pixels whose colour actually changes.
+namespace Text {
+constexpr char FIRST_CHAR = ' ';
+constexpr uint8_t GLYPH_COUNT = 95;
+
+struct Font {
+  uint8_t width;
+  uint8_t height;
+  const uint8_t *rows; // GLYPH_COUNT * height bytes
+};
+
+// A rectangle of pixels placed at (x, y) in screen coordinates, the framebuffer or a tile
+struct Canvas {
+  uint16_t *pixels;
+  uint16_t stride; // pixels per row
+  int16_t x;
+  int16_t y;
+  uint16_t width;
+  uint16_t height;
+};
+
+// Screen area that changed, right and bottom are exclusive, empty if right <= left
+struct Damage {
+  int16_t left;
+  int16_t top;
+  int16_t right;
+  int16_t bottom;
+};
+
+// Bit for bit the glyphs of the legacy tables, ascii_1206 and ascii_1608
+extern const Font FONT_12;
+extern const Font FONT_16;
+
+// The size argument of LCD::drawChar/drawString, 12 or 16
+const Font &forSize(uint8_t size);
+
+uint16_t measure(const char *str, const Font &font);
+// Characters outside the font are drawn as '?', everything is clipped to the canvas
+ITCM_FUNC Damage draw(const Canvas &canvas, int16_t x, int16_t y, const char *str, const Font &font, uint16_t fg,
+                      uint16_t bg);
+
+// Column-major tables: two bytes per column, upper 8 rows then lower 8, MSB first
+template <size_t BYTES, size_t HEIGHT>
+constexpr std::array<uint8_t, GLYPH_COUNT * HEIGHT> buildAtlas(const unsigned char (&font)[GLYPH_COUNT][BYTES]) {
+  std::array<uint8_t, GLYPH_COUNT * HEIGHT> rows{};
+  for (size_t glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+    for (size_t t = 0; t < BYTES; t++) {
+      for (size_t bit = 0; bit < 8; bit++) {
+        size_t row = bit + (t % 2) * 8;
+        if ((font[glyph][t] & (0x80 >> bit)) && row < HEIGHT)
+          rows[glyph * HEIGHT + row] |= 0x80 >> (t / 2);
+      }
+    }
+  }
+  return rows;
+}
+} // namespace Text
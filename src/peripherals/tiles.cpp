@@ -0,0 +1,252 @@
+#include "tiles.hpp"
+
+#if ENABLE_LCD && ENABLE_LCD_TILES
+
+#include "blitter.hpp"
+#include "image.hpp"
+#include "lcd.hpp"
+#include "lines.hpp"
+
+#include <cstring>
+
+namespace Tiles {
+uint32_t dropped = 0;
+uint16_t commandCount = 0;
+uint16_t commandPeak = 0;
+uint32_t changed = 0;
+Command commands[MAX_COMMANDS];
+char textBuffer[TEXT_SIZE];
+uint16_t textUsed = 0;
+const void *owner = nullptr;
+} // namespace Tiles
+
+static_assert((LCD::HEIGHT + LCD::TILE_ROWS - 1) / LCD::TILE_ROWS <= 32, "one bit per band in Tiles::changed");
+
+namespace {
+// Opaque commands write every pixel of their bounds, whatever lies under them is gone
+inline bool opaque(Tiles::Op op) { return op == Tiles::Op::FILL || op == Tiles::Op::TEXT || op == Tiles::Op::IMAGE; }
+
+inline void touchRows(int32_t top, int32_t bottom) {
+  uint32_t first = top / LCD::TILE_ROWS;
+  uint32_t last = (bottom - 1) / LCD::TILE_ROWS;
+  Tiles::changed |= (0xFFFFFFFFu >> (31 - last)) & ~((1u << first) - 1);
+}
+
+// Drops the commands remove() picks, their text too. Commands keep their order and the
+// strings stay packed in it.
+template <typename Remove> void removeIf(Remove remove) {
+  uint16_t kept = 0;
+  uint16_t textKept = 0;
+  for (uint16_t i = 0; i < Tiles::commandCount; i++) {
+    Tiles::Command &command = Tiles::commands[i];
+    if (remove(command))
+      continue;
+    if (command.op == Tiles::Op::TEXT) {
+      uint16_t length = strlen(&Tiles::textBuffer[command.width]) + 1;
+      memmove(&Tiles::textBuffer[textKept], &Tiles::textBuffer[command.width], length);
+      command.width = textKept;
+      textKept += length;
+    }
+    Tiles::commands[kept++] = command;
+  }
+  Tiles::commandCount = kept;
+  Tiles::textUsed = textKept;
+}
+
+// Adds a command drawing inside [left, right) x [top, bottom), nullptr if nothing of it
+// is on screen or it does not fit. text is the room its string needs.
+Tiles::Command *append(Tiles::Op op, int32_t left, int32_t top, int32_t right, int32_t bottom, uint16_t text = 0) {
+  left = left < 0 ? 0 : left;
+  top = top < 0 ? 0 : top;
+  right = right > LCD::WIDTH ? LCD::WIDTH : right;
+  bottom = bottom > LCD::HEIGHT ? LCD::HEIGHT : bottom;
+  if (left >= right || top >= bottom)
+    return nullptr;
+
+  // Nothing of a covered command would show, its bands are drawn again anyway
+  if (opaque(op))
+    removeIf([&](const Tiles::Command &command) {
+      return command.left >= left && command.right <= right && command.top >= top && command.bottom <= bottom;
+    });
+
+  if (Tiles::commandCount == Tiles::MAX_COMMANDS || Tiles::textUsed + text > Tiles::TEXT_SIZE) {
+    Tiles::dropped++;
+    return nullptr;
+  }
+  Tiles::Command *command = &Tiles::commands[Tiles::commandCount++];
+  if (Tiles::commandCount > Tiles::commandPeak)
+    Tiles::commandPeak = Tiles::commandCount;
+  command->op = op;
+  command->owner = Tiles::owner;
+  command->left = left;
+  command->top = top;
+  command->right = right;
+  command->bottom = bottom;
+  touchRows(top, bottom);
+  return command;
+}
+
+// Intersects [start, start + length) with [low, high), false if nothing is left
+inline bool clip(int16_t &start, int16_t &length, int16_t low, int16_t high) {
+  int16_t end = start + length;
+  start = start < low ? low : start;
+  end = end > high ? high : end;
+  length = end - start;
+  return length > 0;
+}
+} // namespace
+
+void Tiles::fill(int16_t x, int16_t y, int16_t width, int16_t height, uint16_t color) {
+  Command *command = append(Op::FILL, x, y, x + width, y + height);
+  if (command == nullptr)
+    return;
+  command->x = x;
+  command->y = y;
+  command->width = width;
+  command->height = height;
+  command->color = color;
+}
+
+void Tiles::line(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) {
+  // Bounding box, both end points included
+  Command *command = append(Op::LINE, x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, (x1 > x2 ? x1 : x2) + 1,
+                            (y1 > y2 ? y1 : y2) + 1);
+  if (command == nullptr)
+    return;
+  command->x = x1;
+  command->y = y1;
+  command->width = x2;
+  command->height = y2;
+  command->color = color;
+}
+
+void Tiles::text(int16_t x, int16_t y, const char *str, const Text::Font &font, uint16_t fg, uint16_t bg) {
+  if (*str == '\0')
+    return;
+  size_t length = strlen(str) + 1;
+  Command *command = append(Op::TEXT, x, y, x + (int32_t)(length - 1) * font.width, y + font.height, length);
+  if (command == nullptr)
+    return;
+  memcpy(&textBuffer[textUsed], str, length);
+  command->x = x;
+  command->y = y;
+  command->width = textUsed;
+  command->height = font.height;
+  command->color = fg;
+  command->background = bg;
+  command->font = &font;
+  textUsed += length;
+}
+
+void Tiles::image(int16_t x, int16_t y, int16_t width, int16_t height, const uint16_t *pixels) {
+  Command *command = append(Op::IMAGE, x, y, x + width, y + height);
+  if (command == nullptr)
+    return;
+  command->x = x;
+  command->y = y;
+  command->width = width;
+  command->height = height;
+  command->pixels = pixels;
+}
+
+void Tiles::sprite(int16_t x, int16_t y, int16_t width, int16_t height, const uint8_t *image) {
+  Command *command = append(Op::SPRITE, x, y, x + width, y + height);
+  if (command == nullptr)
+    return;
+  command->x = x;
+  command->y = y;
+  command->width = width;
+  command->height = height;
+  command->image = image;
+}
+
+void Tiles::trace(int16_t x, int16_t y, int16_t width, const uint8_t *rows, uint16_t count, uint16_t color) {
+  // A sample is at most 255 rows below y
+  Command *command = append(Op::TRACE, x, y, x + width, y + 256);
+  if (command == nullptr)
+    return;
+  command->x = x;
+  command->y = y;
+  command->width = width;
+  command->height = count;
+  command->color = color;
+  command->rows = rows;
+}
+
+void Tiles::begin(const void *owner) {
+  removeIf([&](const Command &command) {
+    if (command.owner != owner)
+      return false;
+    touchRows(command.top, command.bottom);
+    return true;
+  });
+  Tiles::owner = owner;
+}
+
+void Tiles::end() { owner = nullptr; }
+
+void Tiles::touch(int16_t y, int16_t height) {
+  int32_t top = y < 0 ? 0 : y;
+  int32_t bottom = y + height > LCD::HEIGHT ? LCD::HEIGHT : y + height;
+  if (top < bottom)
+    touchRows(top, bottom);
+}
+
+void Tiles::render(uint16_t *pixels, uint16_t width, int16_t y, uint8_t rows) {
+  Blitter::fill(pixels, width, width, rows, LCD::BACK_COLOR);
+  int16_t bottom = y + rows;
+
+  // In order, later commands draw over earlier ones like they would in a framebuffer
+  for (uint16_t i = 0; i < commandCount; i++) {
+    const Command &command = commands[i];
+    if (command.top >= bottom || command.bottom <= y)
+      continue;
+    int16_t left = command.x, top = command.y;
+    int16_t columns = command.width, lines = command.height;
+
+    switch (command.op) {
+    case Op::FILL:
+      if (clip(left, columns, 0, width) && clip(top, lines, y, bottom))
+        Blitter::fill(pixels + (top - y) * width + left, width, columns, lines, command.color);
+      break;
+    case Op::LINE: {
+      // Clipped to the band on the walk, every band draws its part of the same line
+      Text::Canvas canvas = {pixels, width, 0, y, width, rows};
+      Lines::line(canvas, left, top, columns, lines, command.color);
+      break;
+    }
+    case Op::TEXT:
+      if (top < bottom && top + lines > y) {
+        Text::Canvas canvas = {pixels, width, 0, y, width, rows};
+        Text::draw(canvas, left, top, &textBuffer[command.width], *command.font, command.color, command.background);
+      }
+      break;
+    case Op::IMAGE:
+      if (clip(left, columns, 0, width) && clip(top, lines, y, bottom)) {
+        const uint16_t *source = command.pixels + (top - command.y) * command.width + (left - command.x);
+        Blitter::copy(pixels + (top - y) * width + left, width, source, command.width, columns, lines);
+      }
+      break;
+    case Op::SPRITE:
+      if (top < bottom && top + lines > y) {
+        Text::Canvas canvas = {pixels, width, 0, y, width, rows};
+        Image::decode(canvas, left, top, command.image);
+      }
+      break;
+    case Op::TRACE:
+      if (top < bottom) {
+        Text::Canvas canvas = {pixels, width, 0, y, width, rows};
+        Lines::trace(canvas, left, top, columns, command.rows, lines, command.color);
+      }
+      break;
+    }
+  }
+}
+
+void Tiles::clear() {
+  commandCount = 0;
+  textUsed = 0;
+  touchRows(0, LCD::HEIGHT);
+}
+
+#endif
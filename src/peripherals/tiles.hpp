@@ -0,0 +1,81 @@
+#pragma once
+
+#if ENABLE_LCD && ENABLE_LCD_TILES
+
+#include "../system/tcm.hpp"
+#include "text.hpp"
+
+#include <cstdint>
+
+// Display list for the tile renderer (ENABLE_LCD_TILES)
+//
+// Without a framebuffer the LCD drawing functions append commands here instead of
+// writing pixels. LCD::update() then renders the list band by band into two small
+// buffers, each band is sent by the SPI DMA while the next one is rendered. The list is
+// kept across frames like the picture in a framebuffer would be: every band is drawn
+// from scratch on BACK_COLOR, but only bands whose commands were added or removed since
+// the last update are rendered and sent, so a steady screen costs nothing.
+//
+// A command leaves the list when an opaque one (fill, text, image) is drawn over all of
+// it, when its owner records again, or on clear(). Commands recorded between begin()
+// and end() belong to that owner and replace everything it recorded before, which is
+// how widgets redraw without the list growing. Strings are copied, images, sprites and
+// traces are read by every update that renders their bands and have to stay valid
+// while they are in the list.
+namespace Tiles {
+constexpr uint16_t MAX_COMMANDS = 64; // the stats screen takes about 16
+constexpr uint16_t TEXT_SIZE = 512; // characters of all strings in the list
+
+enum class Op : uint8_t { FILL, LINE, TEXT, IMAGE, SPRITE, TRACE };
+
+struct Command {
+  Op op;
+  int16_t x;
+  int16_t y;
+  int16_t width;  // LINE: second x, TEXT: offset into the text buffer
+  int16_t height; // LINE: second y, TRACE: sample count
+  uint16_t color;
+  uint16_t background;
+  union {
+    const Text::Font *font;
+    const uint16_t *pixels;
+    const uint8_t *image; // SPRITE: compressed, see Image
+    const uint8_t *rows;  // TRACE: samples, see Lines::trace
+  };
+  const void *owner; // nullptr outside begin() and end()
+  // Area on screen the command may draw, right and bottom exclusive
+  uint8_t left;
+  uint8_t top;
+  uint8_t right;
+  uint8_t bottom;
+};
+
+// Commands that did not fit since boot, the screen then misses them
+extern uint32_t dropped;
+extern uint16_t commandCount;
+extern uint16_t commandPeak;
+// Bands to render and send on the next update, bit n covers rows from n * TILE_ROWS
+extern uint32_t changed;
+
+void fill(int16_t x, int16_t y, int16_t width, int16_t height, uint16_t color);
+void line(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+void text(int16_t x, int16_t y, const char *str, const Text::Font &font, uint16_t fg, uint16_t bg);
+void image(int16_t x, int16_t y, int16_t width, int16_t height, const uint16_t *pixels);
+// Decoded again for every band it covers
+void sprite(int16_t x, int16_t y, int16_t width, int16_t height, const uint8_t *image);
+// One command for a whole trace, each band only draws the columns' spans inside it
+void trace(int16_t x, int16_t y, int16_t width, const uint8_t *rows, uint16_t count, uint16_t color);
+
+// Drops what owner recorded so far, the commands up to end() take its place
+void begin(const void *owner);
+void end();
+// Marks the bands of rows [y, y + height) for the next update
+void touch(int16_t y, int16_t height);
+
+// Draws every command into the band of rows [y, y + rows), pixels holds rows * width
+ITCM_FUNC void render(uint16_t *pixels, uint16_t width, int16_t y, uint8_t rows);
+// Empties the list, the whole screen goes back to BACK_COLOR
+void clear();
+} // namespace Tiles
+
+#endif
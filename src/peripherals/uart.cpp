@@ -1,18 +1,79 @@
 #include "uart.hpp"
 
 #include "../error/handler.hpp"
-#include "../system/memory.hpp"
+#include "../system/cycles.hpp"
 #include "../system/scheduler.hpp"
 
+#include <algorithm>
 #include <cstring>
-#include <deque>
-#include <string>
+
+// Transmit ring state, packed into one word so writers reserve and publish with a single CAS
+//   bits  0..12  reserve  end of the space handed out to writers
+//   bits 13..25  commit   end of the data the DMA may send
+//   bits 26..31  writers  reservations still being copied into
+// Indices run modulo 2 * TX_RING_SIZE so a full ring is distinguishable from an empty one.
+// The commit index only moves once the last writer in flight is done, which keeps the
+// published data contiguous without writers ever waiting on each other.
+namespace {
+constexpr uint32_t INDEX_BITS = 13;
+constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+constexpr uint32_t COMMIT_SHIFT = INDEX_BITS;
+constexpr uint32_t WRITERS_SHIFT = 2 * INDEX_BITS;
+constexpr uint32_t WRITERS_MAX = 0xFFFFFFFFu >> WRITERS_SHIFT;
+constexpr uint32_t RING_MASK = UART::TX_RING_SIZE - 1;
+static_assert((UART::TX_RING_SIZE & RING_MASK) == 0, "TX ring size must be a power of two");
+static_assert(2 * UART::TX_RING_SIZE == 1u << INDEX_BITS, "index width does not match the TX ring size");
+static_assert(UART::TX_MAX_CHUNK <= 1024 && UART::TX_RING_SIZE % UART::TX_MAX_CHUNK == 0,
+              "TX chunks must tile the ring without crossing 1 KB pages");
+static_assert((UART::RX_DMA_SIZE & (UART::RX_DMA_SIZE - 1)) == 0 && UART::RX_DMA_SIZE % 32 == 0,
+              "RX buffer must be a power of two covering whole cache lines");
+static_assert(UART::RX_DMA_SIZE <= 0xFFFF, "RX buffer must fit the DMA transfer count");
+
+inline uint32_t reserveIndex(uint32_t state) { return state & INDEX_MASK; }
+inline uint32_t commitIndex(uint32_t state) { return (state >> COMMIT_SHIFT) & INDEX_MASK; }
+inline uint32_t writerCount(uint32_t state) { return state >> WRITERS_SHIFT; }
+} // namespace
 
 namespace UART {
 UART_HandleTypeDef huart1;
 DMA_HandleTypeDef hdma_usart1_tx;
-std::deque<std::string> txBuffers;
-bool dmaBusy = false;
+// DMA1 cannot reach DTCM, the ring has to stay in AXI SRAM
+__attribute__((section(".axi_sram"), aligned(32))) uint8_t txRing[TX_RING_SIZE];
+std::atomic<uint32_t> txState{0};
+volatile uint32_t txTail = 0;   // oldest byte not yet sent, only moved by the DMA owner
+std::atomic<bool> dmaBusy{false}; // owner of the DMA side, set by whoever starts a transfer
+
+uint32_t txChunk = 0;           // length of the transfer in flight
+volatile uint32_t txDiscard = 0; // bytes an OVERWRITE asked to drop after the transfer in flight
+OverflowPolicy overflowPolicy = OverflowPolicy::BLOCK;
+bool txReporting = false;
+
+std::atomic<uint32_t> bytesQueued{0};
+std::atomic<uint32_t> bytesDropped{0};
+std::atomic<uint32_t> blockedWrites{0};
+uint32_t bytesOverwritten = 0;
+uint32_t bytesSent = 0;
+uint32_t transfers = 0;
+uint32_t txIrqCycles = 0;
+
+DMA_HandleTypeDef hdma_usart1_rx;
+// Written by DMA in circular mode, the CPU only ever reads it
+__attribute__((section(".axi_sram"), aligned(32))) uint8_t rxBuffer[RX_DMA_SIZE];
+volatile uint32_t rxHead = 0; // bytes received, free running, rxHead % RX_DMA_SIZE is the DMA position
+volatile uint32_t rxTail = 0; // bytes consumed by read()
+uint32_t rxDmaPos = 0;        // DMA position at the last event
+uint32_t rxRead = 0;
+uint32_t rxOverruns = 0;
+uint32_t rxEvents = 0;
+uint32_t rxErrors = 0;
+uint32_t rxIrqCycles = 0;
+
+static void startReception();
+static void restartReception();
+static void enableFifo();
+static bool baudSettings(uint32_t baudRate, uint32_t &overSampling);
+
+static void startTransfer();
 } // namespace UART
 
 void UART::init() {
@@ -22,7 +83,7 @@ void UART::init() {
 
   // Configure UART
   huart1.Instance = USART1;
-  huart1.Init.BaudRate = 1500000; // 1.5 Mbaud
+  huart1.Init.BaudRate = DEFAULT_BAUD_RATE;
   huart1.Init.WordLength = UART_WORDLENGTH_8B;
   huart1.Init.StopBits = UART_STOPBITS_1;
   huart1.Init.Parity = UART_PARITY_NONE;
@@ -36,8 +97,10 @@ void UART::init() {
   if (HAL_UART_Init(&huart1) != HAL_OK) {
     ErrorHandler::handle(ErrorCode::UART_INIT_FAILED, __FILE__, __LINE__);
   }
+  enableFifo();
 
-  // Configure DMA
+  // Configure DMA, the FIFO packs bytes from the ring into 4 byte bursts on the AXI side
+  // instead of one bus transaction per character
   hdma_usart1_tx.Instance = DMA1_Stream5;
   hdma_usart1_tx.Init.Request = DMA_REQUEST_USART1_TX;
   hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
@@ -47,9 +110,9 @@ void UART::init() {
   hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
   hdma_usart1_tx.Init.Mode = DMA_NORMAL;
   hdma_usart1_tx.Init.Priority = DMA_PRIORITY_HIGH;
-  hdma_usart1_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+  hdma_usart1_tx.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
   hdma_usart1_tx.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
-  hdma_usart1_tx.Init.MemBurst = DMA_MBURST_SINGLE;
+  hdma_usart1_tx.Init.MemBurst = DMA_MBURST_INC4;
   hdma_usart1_tx.Init.PeriphBurst = DMA_PBURST_SINGLE;
 
   if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK) {
@@ -58,11 +121,42 @@ void UART::init() {
 
   __HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
 
-  HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 1, 0);
+  // Receive runs continuously into rxBuffer, the IDLE line, half and full transfer
+  // interrupts only move rxHead so there is no per byte work. The DMA FIFO stays off
+  // here, it would hold back the last bytes of a message past the IDLE event. The
+  // USART RX FIFO covers the DMA latency instead.
+  __HAL_DMA_RESET_HANDLE_STATE(&hdma_usart1_rx);
+  hdma_usart1_rx.Instance = DMA1_Stream6;
+  hdma_usart1_rx.Init.Request = DMA_REQUEST_USART1_RX;
+  hdma_usart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  hdma_usart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
+  hdma_usart1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+  hdma_usart1_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+  hdma_usart1_rx.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+  hdma_usart1_rx.Init.MemBurst = DMA_MBURST_SINGLE;
+  hdma_usart1_rx.Init.PeriphBurst = DMA_PBURST_SINGLE;
+
+  if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::DMA_INIT_FAILED, __FILE__, __LINE__);
+  }
+
+  __HAL_LINKDMA(&huart1, hdmarx, hdma_usart1_rx);
+
+  HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+  // Above SVC (priority 1) so the ring keeps draining while a syscall runs
+  HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
 
   HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(USART1_IRQn);
+
+  startReception();
 }
 
 void UART::mspInit(UART_HandleTypeDef *huart) {
@@ -81,33 +175,360 @@ void UART::mspInit(UART_HandleTypeDef *huart) {
   }
 }
 
+// The 8 byte USART FIFOs ride out DMA arbitration delays that would otherwise cost a
+// gap on the line (TX) or an overrun (RX) at several Mbaud
+void UART::enableFifo() {
+  if (HAL_UARTEx_SetTxFifoThreshold(&huart1, UART_TXFIFO_THRESHOLD_1_8) != HAL_OK ||
+      HAL_UARTEx_SetRxFifoThreshold(&huart1, UART_RXFIFO_THRESHOLD_1_8) != HAL_OK ||
+      HAL_UARTEx_EnableFifoMode(&huart1) != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::UART_INIT_FAILED, __FILE__, __LINE__);
+  }
+}
+
+// Picks the oversampling for a baud rate and checks the divider can hit it closely enough
+bool UART::baudSettings(uint32_t baudRate, uint32_t &overSampling) {
+  if (baudRate == 0 || baudRate > MAX_BAUD_RATE)
+    return false;
+
+  // USART1 runs from PCLK2 (175 MHz), 16x oversampling tops out at 10.9 Mbaud
+  uint32_t clock = HAL_RCC_GetPCLK2Freq();
+  bool over8 = baudRate > clock / 16;
+  uint32_t scaled = over8 ? 2 * clock : clock;
+  uint32_t divider = (scaled + baudRate / 2) / baudRate;
+  if (divider < 16 || divider > 0xFFFF)
+    return false;
+
+  uint32_t actual = scaled / divider;
+  uint32_t deviation = actual > baudRate ? actual - baudRate : baudRate - actual;
+  if ((uint64_t)deviation * 1000 > (uint64_t)baudRate * MAX_BAUD_ERROR)
+    return false;
+
+  overSampling = over8 ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+  return true;
+}
+
+bool UART::configure(uint32_t baudRate, bool loopback) {
+  uint32_t overSampling;
+  if (!baudSettings(baudRate, overSampling))
+    return false;
+
+  // Take the DMA side once the ring is empty. Ownership is only released from the
+  // transfer complete callback, so the last byte has left the shift register too.
+  for (;;) {
+    if (!dmaBusy.exchange(true, std::memory_order_acquire)) {
+      if (commitIndex(txState.load(std::memory_order_acquire)) == txTail)
+        break;
+      startTransfer(); // hands ownership back once the queue is sent
+    }
+    Scheduler::yield();
+  }
+
+  HAL_UART_AbortReceive(&huart1);
+
+  huart1.Init.BaudRate = baudRate;
+  huart1.Init.OverSampling = overSampling;
+  // Single wire mode connects TX to RX inside the USART, TX stays on the pin
+  HAL_StatusTypeDef status = loopback ? HAL_HalfDuplex_Init(&huart1) : HAL_UART_Init(&huart1);
+  if (status != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::UART_INIT_FAILED, __FILE__, __LINE__);
+  }
+  enableFifo();
+
+  restartReception();
+  // Releases the DMA again, or sends what was written in the meantime
+  startTransfer();
+  return true;
+}
+
+uint32_t UART::getBaudRate() { return huart1.Init.BaudRate; }
+
+// Claim len bytes of free space, returns false if the ring cannot hold them right now
+static bool reserve(uint32_t len, uint32_t &start) {
+  uint32_t state = UART::txState.load(std::memory_order_relaxed);
+  uint32_t next;
+  do {
+    uint32_t used = (reserveIndex(state) - UART::txTail) & INDEX_MASK;
+    if (len > UART::TX_RING_SIZE - used || writerCount(state) == WRITERS_MAX)
+      return false;
+    start = reserveIndex(state);
+    next = (state & ~INDEX_MASK) | ((start + len) & INDEX_MASK);
+    next += 1u << WRITERS_SHIFT;
+  } while (!UART::txState.compare_exchange_weak(state, next, std::memory_order_acquire, std::memory_order_relaxed));
+  return true;
+}
+
+// Finish a reservation, the last writer out publishes everything reserved so far
+static void commit() {
+  uint32_t state = UART::txState.load(std::memory_order_relaxed);
+  uint32_t next;
+  do {
+    next = state - (1u << WRITERS_SHIFT);
+    if (writerCount(next) == 0)
+      next = (next & ~(INDEX_MASK << COMMIT_SHIFT)) | (reserveIndex(next) << COMMIT_SHIFT);
+  } while (!UART::txState.compare_exchange_weak(state, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+static void copyIn(uint32_t start, const char *buf, uint32_t len) {
+  uint32_t pos = start & RING_MASK;
+  uint32_t first = std::min(len, UART::TX_RING_SIZE - pos);
+  memcpy(&UART::txRing[pos], buf, first);
+  memcpy(&UART::txRing[0], buf + first, len - first);
+}
+
+// Only thread mode can wait. A handler, the SVC included, may have preempted a writer
+// whose reservation holds back the commit index or the interrupt that drains the ring.
+static bool canBlock() { return __get_IPSR() == 0; }
+
+// Drop queued data that has not been handed to the DMA yet to make room for len bytes
+static void overwriteOldest(uint32_t len) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint32_t state = UART::txState.load(std::memory_order_relaxed);
+  uint32_t tail = UART::txTail;
+  uint32_t used = (reserveIndex(state) - tail) & INDEX_MASK;
+  uint32_t needed = len > UART::TX_RING_SIZE - used ? len - (UART::TX_RING_SIZE - used) : 0;
+  uint32_t inFlight = UART::dmaBusy.load(std::memory_order_relaxed) ? UART::txChunk : 0;
+  uint32_t committed = (commitIndex(state) - tail) & INDEX_MASK;
+  uint32_t unsent = committed > inFlight + UART::txDiscard ? committed - inFlight - UART::txDiscard : 0;
+  uint32_t discard = std::min(needed, unsent);
+
+  if (discard) {
+    if (UART::dmaBusy.load(std::memory_order_relaxed)) {
+      // Bytes in flight cannot be reused, skip past the dropped data once the transfer is done
+      UART::txDiscard += discard;
+    } else {
+      UART::txTail = (tail + discard) & INDEX_MASK;
+    }
+    UART::bytesOverwritten += discard;
+  }
+
+  __set_PRIMASK(primask);
+}
+
+// Called with dmaBusy owned, sends the next contiguous chunk or releases ownership
+void UART::startTransfer() {
+  for (;;) {
+    if (txDiscard) {
+      uint32_t primask = __get_PRIMASK();
+      __disable_irq();
+      uint32_t pending = (commitIndex(txState.load(std::memory_order_relaxed)) - txTail) & INDEX_MASK;
+      txTail = (txTail + std::min((uint32_t)txDiscard, pending)) & INDEX_MASK;
+      txDiscard = 0;
+      __set_PRIMASK(primask);
+    }
+
+    uint32_t tail = txTail;
+    uint32_t pending = (commitIndex(txState.load(std::memory_order_acquire)) - tail) & INDEX_MASK;
+    if (pending == 0) {
+      dmaBusy.store(false, std::memory_order_release);
+      // A writer may have committed after the load above and seen the DMA still busy
+      if (commitIndex(txState.load(std::memory_order_acquire)) == tail || dmaBusy.exchange(true))
+        return;
+      continue;
+    }
+
+    // Up to the next chunk boundary, which includes the end of the ring, the rest goes
+    // out as further transfers
+    uint32_t pos = tail & RING_MASK;
+    uint32_t len = std::min(pending, TX_MAX_CHUNK - pos % TX_MAX_CHUNK);
+    txChunk = len;
+
+    // DMA reads memory, not the cache. The linker keeps .axi_sram inside the write-through
+    // MPU region, the clean makes sure the ring is right even if that region changes
+    SCB_CleanDCache_by_Addr((uint32_t *)((uint32_t)&txRing[pos] & ~31u), len + ((uint32_t)&txRing[pos] & 31u));
+
+    if (HAL_UART_Transmit_DMA(&huart1, &txRing[pos], len) != HAL_OK) {
+      // Drop what is queued so the error report below does not retry the same transfer
+      txTail = (tail + pending) & INDEX_MASK;
+      bytesDropped.fetch_add(pending, std::memory_order_relaxed);
+      dmaBusy.store(false, std::memory_order_release);
+      if (!txReporting) {
+        txReporting = true;
+        ErrorHandler::handle(ErrorCode::UART_TRANSMIT_FAILED, __FILE__, __LINE__);
+        txReporting = false;
+      }
+    }
+    return;
+  }
+}
+
 int UART::write(const char *buf, int count) {
   if (count <= 0)
     return 0;
 
-  txBuffers.push_back(std::string(buf, count));
+  uint32_t remaining = count;
+  bool blocked = false;
+
+  while (remaining) {
+    // BLOCK may split a write across several reservations, the others keep it whole
+    uint32_t len = remaining;
+    if (overflowPolicy == OverflowPolicy::BLOCK && canBlock())
+      len = std::min(remaining, TX_RING_SIZE / 2);
+
+    uint32_t start;
+    bool fits = len <= TX_RING_SIZE && reserve(len, start);
+    if (!fits && len <= TX_RING_SIZE && !canBlock() && overflowPolicy == OverflowPolicy::OVERWRITE) {
+      // No waiting here, one more try once the oldest unsent data made room
+      overwriteOldest(len);
+      fits = reserve(len, start);
+    }
+
+    if (fits) {
+      copyIn(start, buf, len);
+      commit();
+      bytesQueued.fetch_add(len, std::memory_order_relaxed);
+      buf += len;
+      remaining -= len;
 
-  if (!dmaBusy) {
-    const char *txBuffer = txBuffers.front().c_str();
-    if (HAL_UART_Transmit_DMA(&huart1, (uint8_t *)txBuffer, txBuffers.front().size()) != HAL_OK) {
-      ErrorHandler::handle(ErrorCode::UART_TRANSMIT_FAILED, __FILE__, __LINE__);
-      return -1;
+      if (!dmaBusy.exchange(true, std::memory_order_acquire))
+        startTransfer();
+      continue;
     }
+
+    // Handlers drop the whole write, a log or telemetry frame is never sent in part
+    if (len > TX_RING_SIZE || !canBlock() || overflowPolicy == OverflowPolicy::DROP) {
+      bytesDropped.fetch_add(remaining, std::memory_order_relaxed);
+      break;
+    }
+
+    if (overflowPolicy == OverflowPolicy::OVERWRITE)
+      overwriteOldest(len);
+
+    if (!blocked) {
+      blocked = true;
+      blockedWrites.fetch_add(1, std::memory_order_relaxed);
+    }
+    Scheduler::yield();
   }
 
-  dmaBusy = true;
-  return count;
+  return count - remaining;
+}
+
+uint32_t UART::txFree() {
+  uint32_t used = (reserveIndex(txState.load(std::memory_order_relaxed)) - txTail) & INDEX_MASK;
+  return TX_RING_SIZE - used;
 }
 
 void UART::dmaCallback() {
-  txBuffers.pop_front();
-  if (txBuffers.empty()) {
-    dmaBusy = false;
-    return;
+  uint32_t start = Cycles::now();
+  txTail = (txTail + txChunk) & INDEX_MASK;
+  bytesSent += txChunk;
+  transfers++;
+  txChunk = 0;
+  startTransfer();
+  txIrqCycles += Cycles::since(start);
+}
+
+void UART::setOverflowPolicy(OverflowPolicy policy) { overflowPolicy = policy; }
+
+UART::OverflowPolicy UART::getOverflowPolicy() { return overflowPolicy; }
+
+UART::TxStats UART::getTxStats() {
+  TxStats stats;
+  stats.bytesQueued = bytesQueued.load(std::memory_order_relaxed);
+  stats.bytesSent = bytesSent;
+  stats.bytesDropped = bytesDropped.load(std::memory_order_relaxed);
+  stats.bytesOverwritten = bytesOverwritten;
+  stats.transfers = transfers;
+  stats.blockedWrites = blockedWrites.load(std::memory_order_relaxed);
+  stats.irqCycles = txIrqCycles;
+  return stats;
+}
+
+void UART::startReception() {
+  rxDmaPos = 0;
+  // Nothing on the CPU side writes the buffer, dropping the lines is safe
+  SCB_InvalidateDCache_by_Addr(rxBuffer, RX_DMA_SIZE);
+  if (HAL_UARTEx_ReceiveToIdle_DMA(&huart1, rxBuffer, RX_DMA_SIZE) != HAL_OK) {
+    ErrorHandler::handle(ErrorCode::UART_RECEIVE_FAILED, __FILE__, __LINE__);
   }
+}
 
-  const char *txBuffer = txBuffers.front().c_str();
-  if (HAL_UART_Transmit_DMA(&huart1, (uint8_t *)txBuffer, txBuffers.front().size()) != HAL_OK) {
-    ErrorHandler::handle(ErrorCode::UART_TRANSMIT_FAILED, __FILE__, __LINE__);
+// size is the DMA position inside rxBuffer, RX_DMA_SIZE on the full transfer event
+void UART::rxEventCallback(uint16_t size) {
+  uint32_t start = Cycles::now();
+  // Half and full transfer events guarantee less than one lap between two calls
+  uint32_t received = (size + RX_DMA_SIZE - rxDmaPos) % RX_DMA_SIZE;
+  rxDmaPos = size % RX_DMA_SIZE;
+  rxHead = rxHead + received;
+  rxEvents++;
+  rxIrqCycles += Cycles::since(start);
+}
+
+void UART::rxErrorCallback() {
+  // HAL aborts reception on overrun, framing or DMA errors, restart it and drop unread data
+  rxErrors++;
+  if (huart1.RxState != HAL_UART_STATE_READY)
+    return; // noise, framing and parity errors leave the DMA running
+
+  rxOverruns += rxHead - rxTail;
+  restartReception();
+}
+
+// A restarted transfer writes from the start of the buffer again, move the ring to the
+// next lap so rxHead % RX_DMA_SIZE keeps matching the DMA position
+void UART::restartReception() {
+  uint32_t aligned = (rxHead + RX_DMA_SIZE - 1) & ~(RX_DMA_SIZE - 1);
+  rxHead = aligned;
+  rxTail = aligned;
+  startReception();
+}
+
+uint32_t UART::available() {
+  uint32_t pending = rxHead - rxTail;
+  return pending > RX_DMA_SIZE ? RX_DMA_SIZE : pending;
+}
+
+int UART::read(char *buf, int count, uint32_t timeoutMs) {
+  if (count <= 0)
+    return 0;
+
+  // Yields until data arrives or the timeout expires, a timeout of 0 never yields and
+  // is the only one allowed in handler mode
+  uint32_t start = HAL_GetTick();
+  while (rxHead == rxTail) {
+    if (timeoutMs != RX_WAIT_FOREVER && HAL_GetTick() - start >= timeoutMs)
+      return 0;
+    Scheduler::yield();
+  }
+
+  // The error callback may realign the ring, copy out with interrupts masked
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint32_t tail = rxTail;
+  uint32_t pending = rxHead - tail;
+  if (pending > RX_DMA_SIZE) {
+    // Reader fell a whole lap behind, the oldest data is already overwritten
+    rxOverruns += pending - RX_DMA_SIZE;
+    tail = rxHead - RX_DMA_SIZE;
+    pending = RX_DMA_SIZE;
   }
-}
\ No newline at end of file
+
+  uint32_t len = pending < (uint32_t)count ? pending : (uint32_t)count;
+  uint32_t pos = tail % RX_DMA_SIZE;
+  uint32_t first = std::min(len, RX_DMA_SIZE - pos);
+
+  // Drop stale cache lines, the buffer is only written by the DMA
+  SCB_InvalidateDCache_by_Addr(rxBuffer, RX_DMA_SIZE);
+  memcpy(buf, &rxBuffer[pos], first);
+  memcpy(buf + first, &rxBuffer[0], len - first);
+
+  rxTail = tail + len;
+  rxRead += len;
+
+  __set_PRIMASK(primask);
+  return len;
+}
+
+UART::RxStats UART::getRxStats() {
+  RxStats stats;
+  stats.bytesReceived = rxHead;
+  stats.bytesRead = rxRead;
+  stats.overruns = rxOverruns;
+  stats.events = rxEvents;
+  stats.errors = rxErrors;
+  stats.irqCycles = rxIrqCycles;
+  return stats;
+}
@@ -1,20 +1,84 @@
 #pragma once
 
+#include "../system/tcm.hpp"
 #include "stm32h7xx.h"
 #include "stm32h7xx_hal.h"
 
+#include <atomic>
 #include <cstddef>
-#include <deque>
-#include <string>
+#include <cstdint>
 
 namespace UART {
+constexpr uint32_t DEFAULT_BAUD_RATE = 1500000;
+// Above USART kernel clock / 16 configure() switches to 8x oversampling
+constexpr uint32_t MAX_BAUD_RATE = 12000000;
+// Accepted deviation of the generated baud rate, in 0.1 %
+constexpr uint32_t MAX_BAUD_ERROR = 20;
+// Transmit ring, power of two, lives in AXI SRAM so DMA1 can read it
+constexpr uint32_t TX_RING_SIZE = 4096;
+// Largest single DMA transfer, bounds how long an OVERWRITE waits for the DMA.
+// Transfers never cross a multiple of it, which keeps DMA bursts inside 1 KB pages.
+constexpr uint32_t TX_MAX_CHUNK = 1024;
+// Circular DMA receive buffer, doubles as the RX ring, multiple of the cache line.
+// 3.4 ms of input at 12 Mbaud, so a reader that yields once per tick keeps up.
+constexpr uint32_t RX_DMA_SIZE = 4096;
+constexpr uint32_t RX_WAIT_FOREVER = 0xFFFFFFFF;
+
+// What write() does when the ring has no room for the data
+enum class OverflowPolicy : uint8_t {
+  BLOCK,    // wait for the DMA to drain (drops in handler mode, SVC included)
+  DROP,     // discard the new data
+  OVERWRITE // discard the oldest data not yet handed to the DMA
+};
+
+struct TxStats {
+  uint32_t bytesQueued;
+  uint32_t bytesSent;
+  uint32_t bytesDropped;
+  uint32_t bytesOverwritten;
+  uint32_t transfers;
+  uint32_t blockedWrites;
+  uint32_t irqCycles; // spent in the transfer complete callback
+};
+
+struct RxStats {
+  uint32_t bytesReceived;
+  uint32_t bytesRead;
+  uint32_t overruns; // bytes lost because the reader fell behind by a whole buffer
+  uint32_t events;   // idle line, half and full transfer interrupts
+  uint32_t errors;
+  uint32_t irqCycles; // spent in the receive event callback
+};
+
 void init();
 void mspInit(UART_HandleTypeDef *huart);
+// Waits for queued output to drain, then reprograms the USART. Input not yet read is
+// dropped. loopback selects single wire mode, where the receiver hears the transmitter.
+bool configure(uint32_t baudRate, bool loopback = false);
+uint32_t getBaudRate();
+// Returns the bytes queued. Only BLOCK in thread mode may split a write, everywhere else
+// it is queued whole or dropped whole and counted in bytesDropped.
 int write(const char *buf, int count);
-void dmaCallback();
+uint32_t txFree();
+ITCM_FUNC void dmaCallback();
+int read(char *buf, int count, uint32_t timeoutMs = RX_WAIT_FOREVER);
+uint32_t available();
+ITCM_FUNC void rxEventCallback(uint16_t size);
+void rxErrorCallback();
+
+void setOverflowPolicy(OverflowPolicy policy);
+OverflowPolicy getOverflowPolicy();
+TxStats getTxStats();
+RxStats getRxStats();
 
 extern UART_HandleTypeDef huart1;
 extern DMA_HandleTypeDef hdma_usart1_tx;
-extern std::deque<std::string> txBuffers;
-extern bool dmaBusy;
-} // namespace UART
\ No newline at end of file
+extern DMA_HandleTypeDef hdma_usart1_rx;
+extern uint8_t txRing[TX_RING_SIZE];
+extern std::atomic<uint32_t> txState;
+extern volatile uint32_t txTail;
+extern std::atomic<bool> dmaBusy;
+extern uint8_t rxBuffer[RX_DMA_SIZE];
+extern volatile uint32_t rxHead;
+extern volatile uint32_t rxTail;
+} // namespace UART
@@ -0,0 +1,195 @@
+#include "ui.hpp"
+
+#if ENABLE_LCD
+
+#include "../error/handler.hpp"
+#include "tiles.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+// LCD::fillRect rejects anything reaching past the screen, scrolled widgets may
+void fillClipped(int16_t x, int16_t y, int16_t width, int16_t height, uint16_t color) {
+  int16_t right = x + width;
+  int16_t bottom = y + height;
+  x = x < 0 ? 0 : x;
+  y = y < 0 ? 0 : y;
+  right = right > LCD::WIDTH ? LCD::WIDTH : right;
+  bottom = bottom > LCD::HEIGHT ? LCD::HEIGHT : bottom;
+  if (x < right && y < bottom)
+    LCD::fillRect(x, y, right - x, bottom - y, color);
+}
+
+// Maps value from [min, max] onto [0, steps], clamped
+uint8_t scale(int32_t value, int32_t min, int32_t max, uint8_t steps) {
+  if (value <= min || max <= min)
+    return 0;
+  if (value >= max)
+    return steps;
+  return (int64_t)(value - min) * steps / (max - min);
+}
+} // namespace
+
+void UI::Widget::draw(int16_t offset) {
+  if (!stale)
+    return;
+#if ENABLE_LCD_TILES
+  // The display list keeps what the widget drew last, it is replaced as a whole and the
+  // area under it is the screen background again
+  Tiles::begin(this);
+  render(offset, true);
+  Tiles::end();
+#else
+  render(offset, cleared);
+#endif
+  stale = false;
+  cleared = false;
+}
+
+void UI::Widget::invalidate(bool cleared) {
+  stale = true;
+  this->cleared |= cleared;
+}
+
+UI::Label::Label(int16_t x, int16_t y, const Text::Font &font, uint16_t fg, uint16_t bg)
+    : Widget(x, y, LCD::WIDTH, font.height), font(&font), fg(fg), bg(bg) {}
+
+void UI::Label::place(int16_t x, int16_t y) {
+  this->x = x;
+  this->y = y;
+  invalidate(false);
+}
+
+void UI::Label::set(const char *text) {
+  if (strncmp(this->text, text, LABEL_LENGTH - 1) == 0)
+    return;
+  strncpy(this->text, text, LABEL_LENGTH - 1);
+  this->text[LABEL_LENGTH - 1] = '\0';
+  invalidate(false);
+}
+
+void UI::Label::format(const char *fmt, ...) {
+  char line[LABEL_LENGTH];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  set(line);
+}
+
+void UI::Label::render(int16_t offset, bool cleared) {
+  if (cleared)
+    drawnWidth = 0;
+
+  // The text only writes the pixels that differ, the tail of a longer old text is erased
+  uint8_t textWidth = Text::measure(text, *font);
+  LCD::drawText(x, y - offset, text, *font, fg, bg);
+  if (drawnWidth > textWidth)
+    fillClipped(x + textWidth, y - offset, drawnWidth - textWidth, height, bg);
+  drawnWidth = textWidth;
+}
+
+UI::Gauge::Gauge(int16_t x, int16_t y, uint8_t width, uint8_t height, int32_t min, int32_t max, uint16_t fg,
+                 uint16_t bg)
+    : Widget(x, y, width, height), min(min), max(max), fg(fg), bg(bg) {}
+
+void UI::Gauge::set(int32_t value) {
+  uint8_t level = scale(value, min, max, width);
+  if (level == fill)
+    return;
+  fill = level;
+  invalidate(false);
+}
+
+void UI::Gauge::render(int16_t offset, bool cleared) {
+  if (cleared) {
+    fillClipped(x, y - offset, fill, height, fg);
+    fillClipped(x + fill, y - offset, width - fill, height, bg);
+  } else if (fill > drawn) {
+    fillClipped(x + drawn, y - offset, fill - drawn, height, fg);
+  } else {
+    fillClipped(x + fill, y - offset, drawn - fill, height, bg);
+  }
+  drawn = fill;
+}
+
+UI::Plot::Plot(int16_t x, int16_t y, uint8_t width, uint8_t height, int32_t min, int32_t max, uint16_t fg,
+               uint16_t bg)
+    : Widget(x, y, width < LCD::WIDTH ? width : LCD::WIDTH, height), min(min), max(max), fg(fg), bg(bg) {
+  memset(top, 0xFF, sizeof(top));
+}
+
+void UI::Plot::set(uint8_t column, int32_t value) {
+  if (column >= width)
+    return;
+  // Row 0 is the top of the plot, larger values go up
+  uint8_t level = height - 1 - scale(value, min, max, height - 1);
+  if (level == levels[column])
+    return;
+  levels[column] = level;
+  invalidate(false);
+}
+
+void UI::Plot::render(int16_t offset, bool cleared) {
+#if ENABLE_LCD_TILES
+  // Always drawn whole, one trace command instead of a span per column
+  (void)cleared;
+  fillClipped(x, y - offset, width, height, bg);
+  LCD::drawTrace(x, y - offset, width, levels, width, fg);
+#else
+  if (cleared) {
+    fillClipped(x, y - offset, width, height, bg);
+    memset(top, 0xFF, sizeof(top));
+    memset(bottom, 0, sizeof(bottom));
+  }
+
+  for (uint8_t column = 0; column < width; column++) {
+    // Each column spans from the previous sample to its own, which joins the trace
+    uint8_t from = levels[column > 0 ? column - 1 : 0];
+    uint8_t to = levels[column];
+    uint8_t spanTop = from < to ? from : to;
+    uint8_t spanBottom = from < to ? to : from;
+    if (spanTop == top[column] && spanBottom == bottom[column])
+      continue;
+
+    if (top[column] <= bottom[column])
+      fillClipped(x + column, y + top[column] - offset, 1, bottom[column] - top[column] + 1, bg);
+    fillClipped(x + column, y + spanTop - offset, 1, spanBottom - spanTop + 1, fg);
+    top[column] = spanTop;
+    bottom[column] = spanBottom;
+  }
+#endif
+}
+
+void UI::Screen::add(Widget &widget) {
+  if (count == MAX_WIDGETS) {
+    ErrorHandler::handle(ErrorCode::UI_WIDGET_LIMIT, __FILE__, __LINE__);
+    return;
+  }
+  widgets[count++] = &widget;
+  widget.invalidate(false);
+}
+
+void UI::Screen::scrollTo(int16_t position) {
+  if (position == offset)
+    return;
+  offset = position;
+  invalidate();
+}
+
+void UI::Screen::invalidate() { painted = false; }
+
+void UI::Screen::render() {
+  if (!painted) {
+    LCD::fillRect(0, 0, LCD::WIDTH, LCD::HEIGHT, background);
+    for (uint8_t i = 0; i < count; i++)
+      widgets[i]->invalidate(true);
+    painted = true;
+  }
+  for (uint8_t i = 0; i < count; i++)
+    widgets[i]->draw(offset);
+}
+
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+#if ENABLE_LCD
+
+#include "lcd.hpp"
+#include "text.hpp"
+
+#include <cstdint>
+
+// Retained-mode widgets on top of the LCD framebuffer
+//
+// Widgets keep the value they show and only draw when it changes, so a screen whose
+// values are steady costs no drawing and, through the dirty rectangles, no SPI traffic.
+// Setters compare against the cached value and mark the widget stale, Screen::render
+// draws the stale ones. Everything a widget draws stays inside its own bounds.
+namespace UI {
+constexpr uint8_t MAX_WIDGETS = 32;
+constexpr uint8_t LABEL_LENGTH = 32;
+
+class Widget {
+public:
+  Widget(int16_t x, int16_t y, uint8_t width, uint8_t height) : x(x), y(y), width(width), height(height) {}
+
+  // Draws the widget if its value changed, offset scrolls it up by that many rows
+  void draw(int16_t offset);
+  // Redraws everything on the next draw, cleared means the area now holds the screen
+  // background and nothing of the widget
+  void invalidate(bool cleared);
+
+protected:
+  ~Widget() = default;
+  virtual void render(int16_t offset, bool cleared) = 0;
+
+  int16_t x;
+  int16_t y;
+  uint8_t width;
+  uint8_t height;
+  bool stale = true;
+  bool cleared = true;
+};
+
+// One line of text, shorter text than last time is padded with the background
+class Label : public Widget {
+public:
+  Label(int16_t x = 0, int16_t y = 0, const Text::Font &font = Text::FONT_12, uint16_t fg = LCD::POINT_COLOR,
+        uint16_t bg = LCD::BACK_COLOR);
+
+  // Moves a label that has not been drawn yet, or before the screen is cleared
+  void place(int16_t x, int16_t y);
+  void set(const char *text);
+  void format(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+  void render(int16_t offset, bool cleared) override;
+
+  const Text::Font *font;
+  uint16_t fg;
+  uint16_t bg;
+  uint8_t drawnWidth = 0; // pixels of text on screen
+  char text[LABEL_LENGTH] = "";
+};
+
+// Horizontal bar, redraws only the strip between the old and the new fill level
+class Gauge : public Widget {
+public:
+  Gauge(int16_t x, int16_t y, uint8_t width, uint8_t height, int32_t min, int32_t max, uint16_t fg, uint16_t bg);
+
+  void set(int32_t value);
+
+private:
+  void render(int16_t offset, bool cleared) override;
+
+  int32_t min;
+  int32_t max;
+  uint16_t fg;
+  uint16_t bg;
+  uint8_t fill = 0;  // pixels the value asks for
+  uint8_t drawn = 0; // pixels on screen
+};
+
+// One sample per column joined by vertical spans, columns whose span did not move
+// are left alone. With ENABLE_LCD_TILES it is drawn as one LCD::drawTrace.
+class Plot : public Widget {
+public:
+  Plot(int16_t x, int16_t y, uint8_t width, uint8_t height, int32_t min, int32_t max, uint16_t fg, uint16_t bg);
+
+  void set(uint8_t column, int32_t value);
+
+private:
+  void render(int16_t offset, bool cleared) override;
+
+  int32_t min;
+  int32_t max;
+  uint16_t fg;
+  uint16_t bg;
+  uint8_t levels[LCD::WIDTH] = {}; // row of each sample inside the plot
+  uint8_t top[LCD::WIDTH] = {};    // span on screen per column, empty if top > bottom
+  uint8_t bottom[LCD::WIDTH] = {};
+};
+
+// A display list of widgets sharing one background and scroll offset
+class Screen {
+public:
+  explicit Screen(uint16_t background = LCD::BACK_COLOR) : background(background) {}
+
+  void add(Widget &widget);
+  // A new offset clears the screen and redraws every widget
+  void scrollTo(int16_t offset);
+  // Clears and redraws everything on the next render, e.g. when switching screens
+  void invalidate();
+  // Draws the stale widgets, LCD::update() then sends what changed
+  void render();
+
+private:
+  Widget *widgets[MAX_WIDGETS];
+  uint8_t count = 0;
+  uint16_t background;
+  int16_t offset = 0;
+  bool painted = false; // background drawn since the last invalidate
+};
+} // namespace UI
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "stm32h7xx.h"
+
+#include <cstdint>
+
+// DWT cycle counter, counts core clock cycles and wraps every ~6 s at 700 MHz
+namespace Cycles {
+void init();
+
+inline uint32_t now() { return DWT->CYCCNT; }
+
+// Cycles elapsed since start, correct across a single wrap
+inline uint32_t since(uint32_t start) { return DWT->CYCCNT - start; }
+
+// Convert cycles to microseconds at the current core clock
+inline uint32_t toMicros(uint32_t cycles) { return cycles / (SystemCoreClock / 1000000); }
+} // namespace Cycles
@@ -0,0 +1,24 @@
+#include "log.hpp"
+
+#include "../peripherals/uart.hpp"
+#include "cycles.hpp"
+
+void Log::init() {
+  // First frame tells the decoder how to turn cycle timestamps into time
+  LOG_EMIT("S", "core clock %lu Hz", SystemCoreClock);
+}
+
+void Log::send(const char *record, uint8_t *frame, size_t length) {
+  // .log_strings is linked at address 0, the record address is its offset in the ELF section
+  uint32_t id = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(record));
+  uint32_t timestamp = Cycles::now();
+
+  frame[0] = FRAME_SYNC;
+  frame[1] = static_cast<uint8_t>(length - 2);
+  frame[2] = id & 0xFF;
+  frame[3] = (id >> 8) & 0xFF;
+  memcpy(&frame[4], &timestamp, sizeof(timestamp));
+
+  // One write is one ring reservation, frames from different tasks never interleave
+  UART::write(reinterpret_cast<const char *>(frame), length);
+}
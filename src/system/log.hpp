@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+// Deferred formatting log
+//
+// With ENABLE_BINARY_LOG the format string never reaches the target's RAM or the wire.
+// Every LOG_* call site places "<level>\x1f<file>\x1f<line>\x1f<format>" in .log_strings,
+// which the linker script keeps in the ELF without loading it, and the frame carries only
+// the 16 bit offset of that record, a cycle timestamp and the raw arguments:
+//
+//   0xFF | length | id (u16) | cycles (u32) | arguments
+//
+// Integers up to 32 bit, pointers and bools are sent as 4 bytes, 64 bit integers as 8,
+// floating point as a 4 byte float and strings as a length byte followed by the text.
+// scripts/log_decode.py rebuilds the text from the ELF. 0xFF never appears in UTF-8 so
+// frames can share the UART with plain printf output and telemetry frames (0xFE).
+//
+// Without ENABLE_BINARY_LOG the same macros fall back to printf.
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_NONE  5
+
+// Calls below this level are compiled out, arguments are not evaluated
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+namespace Log {
+constexpr uint8_t FRAME_SYNC = 0xFF;
+constexpr size_t FRAME_HEADER = 8;
+constexpr size_t FRAME_MAX = 128;
+
+void init();
+void send(const char *record, uint8_t *frame, size_t length);
+
+// Serializes arguments behind the frame header, silently truncates at FRAME_MAX
+class Writer {
+public:
+  Writer(uint8_t *begin, uint8_t *end) : pos(begin), end(end) {}
+
+  template <typename T> void put(T value) {
+    if constexpr (std::is_same_v<T, const char *> || std::is_same_v<T, char *>) {
+      putString(value);
+    } else if constexpr (std::is_floating_point_v<T>) {
+      float f = static_cast<float>(value);
+      putRaw(&f, sizeof(f));
+    } else if constexpr (std::is_pointer_v<T>) {
+      uint32_t v = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(value));
+      putRaw(&v, sizeof(v));
+    } else if constexpr (sizeof(T) > 4) {
+      uint64_t v = static_cast<uint64_t>(value);
+      putRaw(&v, sizeof(v));
+    } else {
+      static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "unsupported log argument type");
+      uint32_t v = static_cast<uint32_t>(value);
+      putRaw(&v, sizeof(v));
+    }
+  }
+
+  uint8_t *position() const { return pos; }
+
+private:
+  void putRaw(const void *data, size_t size) {
+    if (size > static_cast<size_t>(end - pos))
+      size = end - pos;
+    memcpy(pos, data, size);
+    pos += size;
+  }
+
+  void putString(const char *s) {
+    if (pos == end)
+      return;
+    size_t len = s ? strnlen(s, 255) : 0;
+    if (len > static_cast<size_t>(end - pos - 1))
+      len = end - pos - 1;
+    *pos++ = static_cast<uint8_t>(len);
+    putRaw(s, len);
+  }
+
+  uint8_t *pos;
+  uint8_t *end;
+};
+
+template <typename... Args> inline void emit(const char *record, Args... args) {
+  uint8_t frame[FRAME_MAX];
+  Writer writer(frame + FRAME_HEADER, frame + FRAME_MAX);
+  (writer.put(args), ...);
+  send(record, frame, writer.position() - frame);
+}
+} // namespace Log
+
+#define LOG_STRINGIFY_(x) #x
+#define LOG_STRINGIFY(x)  LOG_STRINGIFY_(x)
+
+#if ENABLE_BINARY_LOG
+#define LOG_EMIT(tag, fmt, ...)                                                                                       \
+  do {                                                                                                                \
+    static const char logRecord[] __attribute__((section(".log_strings"), used)) =                                    \
+        tag "\x1f" __FILE__ "\x1f" LOG_STRINGIFY(__LINE__) "\x1f" fmt;                                                \
+    Log::emit(logRecord, ##__VA_ARGS__);                                                                              \
+  } while (0)
+#else
+#define LOG_EMIT(tag, fmt, ...) printf("[" tag "] " fmt "\n", ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(fmt, ...) LOG_EMIT("T", fmt, ##__VA_ARGS__)
+#else
+#define LOG_TRACE(fmt, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) LOG_EMIT("D", fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) LOG_EMIT("I", fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) LOG_EMIT("W", fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) LOG_EMIT("E", fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) ((void)0)
+#endif
@@ -1,6 +1,10 @@
 #include "memory.hpp"
 
 #include "error/handler.hpp"
+#include "cycles.hpp"
+#include "memory_resource.hpp"
+#include "scheduler.hpp"
+#include "stm32h7xx.h"
 
 #include <cstdio>
 #include <cstring>
@@ -8,148 +12,410 @@
 namespace Memory {
 // Initialize static members
 MemoryRegion heap = {0, 0, 0};
+BlockHeader *blocks = nullptr;
+BlockHeader *checkCursor = nullptr;
+uint32_t checkPasses = 0;
 #if ENABLE_ALLOCATION_TRACKER
 Allocation allocations[MAX_ALLOCATIONS];
 size_t allocationCount = 0;
 #endif
 } // namespace Memory
 
+// Address of a linker symbol
+#define SYM(name) reinterpret_cast<uint32_t>(&name)
+
+static inline Memory::BlockHeader *headerOf(void *ptr) {
+  return reinterpret_cast<Memory::BlockHeader *>(static_cast<char *>(ptr) - sizeof(Memory::BlockHeader));
+}
+
+static inline void *dataOf(Memory::BlockHeader *block) { return reinterpret_cast<char *>(block) + sizeof(Memory::BlockHeader); }
+
+// Total size of a block including header and tail canary
+static inline size_t blockSize(size_t size) { return sizeof(Memory::BlockHeader) + size + sizeof(uint32_t); }
+
+// The tail canary is not necessarily aligned, so it is accessed bytewise
+static inline void writeTail(Memory::BlockHeader *block) {
+  uint32_t tail = Memory::MEMORY_TAIL;
+  memcpy(static_cast<char *>(dataOf(block)) + block->size, &tail, sizeof(tail));
+}
+
+static inline bool tailIntact(Memory::BlockHeader *block) {
+  uint32_t tail;
+  memcpy(&tail, static_cast<char *>(dataOf(block)) + block->size, sizeof(tail));
+  return tail == Memory::MEMORY_TAIL;
+}
+
+// Report a damaged block with the site it was allocated from, does not return
+static void reportCorruption(Memory::BlockHeader *block) {
+  ErrorHandler::handle(ErrorCode::MEMORY_CORRUPTION, block->file ? block->file : "unknown", block->line);
+}
+
+// Check whether block is in the block list, caller must hold interrupts off
+static bool isTracked(Memory::BlockHeader *block) {
+  for (Memory::BlockHeader *b = Memory::blocks; b; b = b->next) {
+    if (b == block)
+      return true;
+  }
+  return false;
+}
+
+// Validate the header of a pointer passed to free/realloc.
+// Returns false for pointers that were not allocated through Memory::malloc.
+static bool checkOwnBlock(Memory::BlockHeader *block) {
+  if (block->magic == Memory::MEMORY_MAGIC) {
+    if (!tailIntact(block))
+      reportCorruption(block);
+    return true;
+  }
+
+  if (block->magic == Memory::MEMORY_FREED) {
+    // double free, the header is still intact as long as the chunk was not reused
+    reportCorruption(block);
+    return true;
+  }
+
+  // Head canary damaged on one of our blocks, or a foreign pointer
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  bool tracked = isTracked(block);
+  __set_PRIMASK(primask);
+  if (tracked)
+    reportCorruption(block);
+  return tracked;
+}
+
+// Link block at the head of the block list, caller must hold interrupts off
+static void linkBlock(Memory::BlockHeader *block) {
+  block->prev = nullptr;
+  block->next = Memory::blocks;
+  if (Memory::blocks)
+    Memory::blocks->prev = block;
+  Memory::blocks = block;
+}
+
+// Remove block from the block list, caller must hold interrupts off
+static void unlinkBlock(Memory::BlockHeader *block) {
+  if (block == Memory::checkCursor)
+    Memory::checkCursor = block->next;
+  if (block->prev)
+    block->prev->next = block->next;
+  else
+    Memory::blocks = block->next;
+  if (block->next)
+    block->next->prev = block->prev;
+}
+
+#if ENABLE_ALLOCATION_TRACKER
+static void trackAllocation(void *ptr, size_t size, const char *file, uint32_t line) {
+  // Track allocation if we have space
+  if (Memory::allocationCount < Memory::MAX_ALLOCATIONS) {
+    Memory::allocations[Memory::allocationCount].ptr = ptr;
+    Memory::allocations[Memory::allocationCount].size = size;
+    Memory::allocations[Memory::allocationCount].file = file;
+    Memory::allocations[Memory::allocationCount].line = line;
+    Memory::allocationCount++;
+  }
+}
+
+static void untrackAllocation(void *ptr) {
+  // Remove allocation from tracking
+  for (size_t i = 0; i < Memory::allocationCount; i++) {
+    if (Memory::allocations[i].ptr == ptr) {
+      // Move all allocations after this one one position back
+      for (size_t j = i; j < Memory::allocationCount - 1; j++) {
+        Memory::allocations[j] = Memory::allocations[j + 1];
+      }
+      Memory::allocationCount--;
+      break;
+    }
+  }
+}
+#endif
+
 void Memory::init() {
   // Calculate heap size from linker symbols
-  heap.start = reinterpret_cast<uint32_t>(&_ebss);
+  heap.start = reinterpret_cast<uint32_t>(&_sheap);
   heap.size = reinterpret_cast<uint32_t>(&_estack) - heap.start;
-  heap.used = 0;
-#if ENABLE_ALLOCATION_TRACKER
-  allocationCount = 0;
-#endif
+  // heap.used and the block list are zero initialized and may already hold
+  // allocations made by static constructors, so they are not reset here
+
+  // Route pmr containers without an explicit resource through the tracked heap
+  std::pmr::set_default_resource(taskHeapResource());
 }
 
 void Memory::getStats(MemoryRegion &flash, MemoryRegion &ram, MemoryRegion &heap) {
-  // Flash usage (code + data)
-  flash.start = 0x08000000; // Start of flash
-  flash.size = 1024 * 1024; // 1MB flash
-  flash.used = reinterpret_cast<uint32_t>(&_sidata) - flash.start;
+  // Flash usage (everything loaded from flash, including ITCM code and .data initializers)
+  flash.start = SYM(__flash_start);
+  flash.size = SYM(__flash_size);
+  flash.used = SYM(_eflash) - flash.start;
 
-  // RAM usage (data + bss)
-  ram.start = 0x24000000; // Start of RAM_D1
-  ram.size = 320 * 1024;  // 320KB RAM
-  ram.used = reinterpret_cast<uint32_t>(&_ebss) - reinterpret_cast<uint32_t>(&_sdata);
+  // RAM_D1 usage (data + bss + axi_sram)
+  ram.start = SYM(__ram_d1_start);
+  ram.size = SYM(__ram_d1_size);
+  ram.used = SYM(_sheap) - ram.start;
 
   // Heap usage
   heap = Memory::heap;
 }
 
-// Magic number to identify our allocations
-constexpr size_t MEMORY_MAGIC = 0xDEADBEEF;
+size_t Memory::getRegions(RegionInfo *regions, size_t max) {
+  const RegionInfo all[REGION_COUNT] = {
+      {"FLASH", SYM(__flash_start), SYM(__flash_size), SYM(_eflash) - SYM(__flash_start)},
+      {"ITCM", SYM(__itcm_start), SYM(__itcm_size), SYM(_eitcm) - SYM(__itcm_start)},
+      {"DTCM", SYM(__dtcm_start), SYM(__dtcm_size), SYM(_edtcm_bss) - SYM(__dtcm_start)},
+      {"RAM_D1", SYM(__ram_d1_start), SYM(__ram_d1_size), SYM(_sheap) - SYM(__ram_d1_start)},
+      {"RAM_D2", SYM(__ram_d2_start), SYM(__ram_d2_size), 0},
+      {"RAM_D3", SYM(__ram_d3_start), SYM(__ram_d3_size), 0},
+  };
+
+  size_t count = max < REGION_COUNT ? max : REGION_COUNT;
+  for (size_t i = 0; i < count; i++) {
+    regions[i] = all[i];
+  }
+  return count;
+}
+
+size_t Memory::getSections(SectionInfo *sections, size_t max) {
+  uint32_t stackStart = SYM(_estack) - SYM(_Min_Stack_Size);
+  const SectionInfo all[SECTION_COUNT] = {
+      {".isr_vector", "FLASH", SYM(_sisr_vector), SYM(_eisr_vector) - SYM(_sisr_vector), SYM(_sisr_vector)},
+      {".itcm_text", "ITCM", SYM(_sitcm), SYM(_eitcm) - SYM(_sitcm), SYM(_siitcm)},
+      {".text", "FLASH", SYM(_stext), SYM(_etext) - SYM(_stext), SYM(_stext)},
+      {".rodata", "FLASH", SYM(_srodata), SYM(_erodata) - SYM(_srodata), SYM(_srodata)},
+      {".dtcm_data", "DTCM", SYM(_sdtcm_data), SYM(_edtcm_data) - SYM(_sdtcm_data), SYM(_sidtcm_data)},
+      {".dtcm_bss", "DTCM", SYM(_sdtcm_bss), SYM(_edtcm_bss) - SYM(_sdtcm_bss), 0},
+      {".data", "RAM_D1", SYM(_sdata), SYM(_edata) - SYM(_sdata), SYM(_sidata)},
+      {".bss", "RAM_D1", SYM(_sbss), SYM(_ebss) - SYM(_sbss), 0},
+      {".axi_sram", "RAM_D1", SYM(_saxi_sram), SYM(_eaxi_sram) - SYM(_saxi_sram), 0},
+      {"heap", "RAM_D1", SYM(_sheap), stackStart - SYM(_sheap), 0},
+      {"stack", "RAM_D1", stackStart, SYM(_Min_Stack_Size), 0},
+  };
+
+  size_t count = max < SECTION_COUNT ? max : SECTION_COUNT;
+  for (size_t i = 0; i < count; i++) {
+    sections[i] = all[i];
+  }
+  return count;
+}
+
+void Memory::printMemoryMap() {
+  RegionInfo regions[REGION_COUNT];
+  SectionInfo sections[SECTION_COUNT];
+  size_t regionCount = getRegions(regions, REGION_COUNT);
+  size_t sectionCount = getSections(sections, SECTION_COUNT);
+
+  printf("Region     Start       Used /   Size\n");
+  for (size_t i = 0; i < regionCount; i++) {
+    printf("%-8s 0x%08lx %6lu / %6lu (%lu%%)\n", regions[i].name, regions[i].start, regions[i].used, regions[i].size,
+           regions[i].used * 100 / regions[i].size);
+  }
+
+  printf("Section     Region   Start       Size   Load\n");
+  for (size_t i = 0; i < sectionCount; i++) {
+    printf("%-11s %-8s 0x%08lx %6lu 0x%08lx\n", sections[i].name, sections[i].region, sections[i].start, sections[i].size,
+           sections[i].load);
+  }
+  printf("Heap in use: %lu B\n", heap.used);
+}
+
+uint32_t Memory::currentOwner() {
+  // Allocations made outside of a running task belong to the kernel
+  if (!Scheduler::active || Scheduler::currentTask == nullptr)
+    return OWNER_KERNEL;
+  return Scheduler::currentTask->id;
+}
 
 void *Memory::malloc(size_t size, const char *file, uint32_t line) {
-  if (size > SIZE_MAX - sizeof(size_t) - sizeof(size_t))
+  if (size > SIZE_MAX - blockSize(0))
     return nullptr; // overflow check
-  void *ptr = ::malloc(size + sizeof(size_t) + sizeof(size_t));
-  if (ptr) {
-    heap.used += size;
-    *reinterpret_cast<size_t *>(ptr) = size | 0x10000000;
-    *reinterpret_cast<size_t *>(static_cast<char *>(ptr) + sizeof(size_t)) = MEMORY_MAGIC;
+  BlockHeader *block = static_cast<BlockHeader *>(::malloc(blockSize(size)));
+  if (!block)
+    return nullptr;
 
+  block->size = size;
+  block->owner = currentOwner();
+  block->file = file;
+  block->line = line;
+  block->magic = MEMORY_MAGIC;
+  writeTail(block);
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  linkBlock(block);
+  heap.used += size;
 #if ENABLE_ALLOCATION_TRACKER
-    // Track allocation if we have space
-    if (allocationCount < MAX_ALLOCATIONS) {
-      allocations[allocationCount].ptr = static_cast<char *>(ptr) + sizeof(size_t);
-      allocations[allocationCount].size = size;
-      allocations[allocationCount].file = file;
-      allocations[allocationCount].line = line;
-      allocationCount++;
-    }
+  trackAllocation(dataOf(block), size, file, line);
 #endif
-  }
-  return ptr ? static_cast<char *>(ptr) + sizeof(size_t) : nullptr;
+  __set_PRIMASK(primask);
+
+  return dataOf(block);
 }
 
 void Memory::free(void *ptr, const char *file, uint32_t line) {
   if (!ptr)
     return;
 
-  void *meta_ptr = static_cast<char *>(ptr) - sizeof(size_t);
-  // Check magic number first (optional, but recommended)
-  size_t magic = *reinterpret_cast<size_t *>(ptr);
-  if (magic != MEMORY_MAGIC) {
-    // Not our allocation, pass to standard free
-    ::free(ptr);
-    return;
-  }
-  // Now check marker bit
-  size_t stored = *reinterpret_cast<size_t *>(meta_ptr);
-  if ((stored & 0x10000000) == 0) {
+  BlockHeader *block = headerOf(ptr);
+  // Check canaries around the user data
+  if (!checkOwnBlock(block)) {
     // Not our allocation, pass to standard free
     ::free(ptr);
     return;
   }
-  // All checks passed
-  size_t size = stored & 0x7FFFFFFF;
-  heap.used -= size;
 
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  unlinkBlock(block);
+  heap.used -= block->size;
 #if ENABLE_ALLOCATION_TRACKER
-  // Remove allocation from tracking
-  for (size_t i = 0; i < allocationCount; i++) {
-    if (allocations[i].ptr == ptr) {
-      // Move all allocations after this one one position back
-      for (size_t j = i; j < allocationCount - 1; j++) {
-        allocations[j] = allocations[j + 1];
-      }
-      allocationCount--;
-      break;
-    }
-  }
+  untrackAllocation(ptr);
 #endif
+  __set_PRIMASK(primask);
 
-  ::free(meta_ptr);
+  block->magic = MEMORY_FREED; // lets a second free of the same pointer be detected
+  ::free(block);
 }
 
 void *Memory::realloc(void *ptr, size_t size, const char *file, uint32_t line) {
-  if (size > SIZE_MAX - sizeof(size_t) - sizeof(size_t))
+  if (size > SIZE_MAX - blockSize(0))
     return nullptr;
   if (!ptr)
     return Memory::malloc(size, file, line);
 
-  void *meta_ptr = static_cast<char *>(ptr) - sizeof(size_t);
-  // Check magic number first
-  size_t magic = *reinterpret_cast<size_t *>(ptr);
-  if (magic != MEMORY_MAGIC) {
+  BlockHeader *block = headerOf(ptr);
+  // Check canaries first
+  if (!checkOwnBlock(block)) {
     // Not our allocation, pass to standard realloc
     return ::realloc(ptr, size);
   }
-  // Now check marker bit
-  size_t stored = *reinterpret_cast<size_t *>(meta_ptr);
-  if ((stored & 0x10000000) == 0) {
-    // Not our allocation, pass to standard realloc
-    return ::realloc(ptr, size);
+
+  // The block may move, so it has to leave the list while it is reallocated
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  unlinkBlock(block);
+  size_t old_size = block->size;
+  BlockHeader *new_block = static_cast<BlockHeader *>(::realloc(block, blockSize(size)));
+  if (!new_block) {
+    linkBlock(block);
+    __set_PRIMASK(primask);
+    return nullptr;
   }
-  // All checks passed
-  size_t old_size = stored & 0x7FFFFFFF;
-  void *new_meta_ptr = ::realloc(meta_ptr, size + sizeof(size_t) + sizeof(size_t));
-  if (new_meta_ptr) {
-    heap.used -= old_size;
-    heap.used += size;
-    *reinterpret_cast<size_t *>(new_meta_ptr) = size | 0x10000000;
-    *reinterpret_cast<size_t *>(static_cast<char *>(new_meta_ptr) + sizeof(size_t)) = MEMORY_MAGIC;
-    void *new_ptr = static_cast<char *>(new_meta_ptr) + sizeof(size_t);
+
+  new_block->size = size;
+  new_block->file = file;
+  new_block->line = line;
+  writeTail(new_block);
+  linkBlock(new_block);
+  heap.used -= old_size;
+  heap.used += size;
+  void *new_ptr = dataOf(new_block);
 
 #if ENABLE_ALLOCATION_TRACKER
-    // Update allocation tracking
-    for (size_t i = 0; i < allocationCount; i++) {
-      if (allocations[i].ptr == ptr) {
-        allocations[i].ptr = new_ptr;
-        allocations[i].size = size;
-        allocations[i].file = file;
-        allocations[i].line = line;
-        break;
-      }
+  // Update allocation tracking
+  for (size_t i = 0; i < allocationCount; i++) {
+    if (allocations[i].ptr == ptr) {
+      allocations[i].ptr = new_ptr;
+      allocations[i].size = size;
+      allocations[i].file = file;
+      allocations[i].line = line;
+      break;
     }
+  }
+#endif
+  __set_PRIMASK(primask);
+
+  return new_ptr;
+}
+
+void Memory::setOwner(void *ptr, uint32_t owner) {
+  if (!ptr)
+    return;
+
+  BlockHeader *block = headerOf(ptr);
+  if (block->magic == MEMORY_MAGIC)
+    block->owner = owner;
+}
+
+size_t Memory::getOwnerUsage(uint32_t owner) {
+  size_t used = 0;
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  for (BlockHeader *block = blocks; block; block = block->next) {
+    if (block->owner == owner)
+      used += block->size;
+  }
+  __set_PRIMASK(primask);
+
+  return used;
+}
+
+size_t Memory::freeOwnedBy(uint32_t owner) {
+  size_t freed = 0;
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  BlockHeader *block = blocks;
+  while (block) {
+    BlockHeader *next = block->next;
+    if (block->owner == owner) {
+      unlinkBlock(block);
+      heap.used -= block->size;
+      freed += block->size;
+#if ENABLE_ALLOCATION_TRACKER
+      untrackAllocation(dataOf(block));
 #endif
+      block->magic = MEMORY_FREED;
+      ::free(block);
+    }
+    block = next;
+  }
+  __set_PRIMASK(primask);
+
+  return freed;
+}
+
+bool Memory::verifySlice(uint32_t cycleBudget) {
+  uint32_t start = Cycles::now();
+  bool passComplete = false;
+
+  do {
+    // One block per critical section keeps the interrupt latency bounded
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (checkCursor == nullptr) {
+      checkCursor = blocks;
+      if (checkCursor == nullptr) {
+        __set_PRIMASK(primask);
+        return true; // empty heap
+      }
+    }
+
+    BlockHeader *block = checkCursor;
+    bool intact = block->magic == MEMORY_MAGIC && tailIntact(block) && (block->next == nullptr || block->next->prev == block) &&
+                  (block->prev != nullptr || block == blocks);
+    checkCursor = block->next;
+    if (checkCursor == nullptr) {
+      checkPasses++;
+      passComplete = true;
+    }
+    __set_PRIMASK(primask);
+
+    if (!intact)
+      reportCorruption(block);
+  } while (!passComplete && Cycles::since(start) < cycleBudget);
 
-    return new_ptr;
+  return passComplete;
+}
+
+void Memory::integrityTask() {
+  while (1) {
+    // Walk the heap in small slices, yielding in between so other tasks keep running
+    while (!verifySlice(HEAP_CHECK_SLICE_CYCLES)) {
+      Scheduler::yield();
+    }
+    Scheduler::yieldDelay(HEAP_CHECK_INTERVAL_MS);
   }
-  return nullptr;
 }
 
 #if ENABLE_ALLOCATION_TRACKER
@@ -1,16 +1,35 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 
-// Linker symbols for memory regions
+// Linker symbols for sections and regions (stm32h723weact.ld)
 extern "C" {
-extern uint32_t _sidata; // Start of initialized data in flash
-extern uint32_t _sdata;  // Start of data section in RAM
-extern uint32_t _edata;  // End of data section in RAM
-extern uint32_t _sbss;   // Start of bss section in RAM
-extern uint32_t _ebss;   // End of bss section in RAM
-extern uint32_t _estack; // End of stack
+extern uint32_t _sisr_vector, _eisr_vector; // Vector table in flash
+extern uint32_t _stext, _etext;             // Code in flash
+extern uint32_t _srodata, _erodata;         // Read-only data in flash
+extern uint32_t _siitcm;                    // Load address of ITCM code in flash
+extern uint32_t _sitcm, _eitcm;             // ITCM code
+extern uint32_t _sidtcm_data;               // Load address of DTCM data in flash
+extern uint32_t _sdtcm_data, _edtcm_data;   // Initialized DTCM data
+extern uint32_t _sdtcm_bss, _edtcm_bss;     // Zero initialized DTCM data
+extern uint32_t _sidata;                    // Start of initialized data in flash
+extern uint32_t _sdata;                     // Start of data section in RAM
+extern uint32_t _edata;                     // End of data section in RAM
+extern uint32_t _sbss;                      // Start of bss section in RAM
+extern uint32_t _ebss;                      // End of bss section in RAM
+extern uint32_t _saxi_sram, _eaxi_sram;     // DMA buffers in AXI SRAM
+extern uint32_t _sheap;                     // Start of heap, after .bss and .axi_sram
+extern uint32_t _estack;                    // End of stack
+extern uint32_t _eflash;                    // End of the flash image
+extern uint32_t _Min_Stack_Size;            // Reserved main stack
+extern uint32_t __flash_start, __flash_size;
+extern uint32_t __itcm_start, __itcm_size;
+extern uint32_t __dtcm_start, __dtcm_size;
+extern uint32_t __ram_d1_start, __ram_d1_size;
+extern uint32_t __ram_d2_start, __ram_d2_size;
+extern uint32_t __ram_d3_start, __ram_d3_size;
 }
 
 namespace Memory {
@@ -21,6 +40,54 @@ struct MemoryRegion {
   uint32_t used;
 };
 
+// Memory region with its static usage, as laid out by the linker script
+struct RegionInfo {
+  const char *name;
+  uint32_t start;
+  uint32_t size;
+  uint32_t used;
+};
+
+// Output section, load is the flash address for sections copied at startup
+struct SectionInfo {
+  const char *name;
+  const char *region;
+  uint32_t start;
+  uint32_t size;
+  uint32_t load;
+};
+
+constexpr size_t REGION_COUNT = 6;
+constexpr size_t SECTION_COUNT = 11;
+
+// Header placed in front of every tracked allocation, blocks are kept in a
+// doubly linked list so all blocks of one owner can be released at once.
+// A tail canary (MEMORY_TAIL) follows the user data of every block.
+struct alignas(8) BlockHeader {
+  BlockHeader *prev;
+  BlockHeader *next;
+  size_t size;
+  uint32_t owner;   // task id of the owner, OWNER_KERNEL for kernel allocations
+  const char *file; // allocation site
+  uint32_t line;
+  uint32_t reserved; // explicit padding so magic ends where the 8 byte aligned header ends
+  size_t magic;      // head canary, must stay the last member, directly in front of user data
+};
+static_assert(sizeof(BlockHeader) == offsetof(BlockHeader, magic) + sizeof(size_t),
+              "head canary must sit directly in front of the user data");
+
+// Canary values
+constexpr size_t MEMORY_MAGIC = 0xDEADBEEF; // head canary of a live block
+constexpr size_t MEMORY_FREED = 0xFEEDFACE; // head canary of a freed block
+constexpr uint32_t MEMORY_TAIL = 0xC0DEC0DE;
+
+// Background heap verification
+constexpr uint32_t HEAP_CHECK_SLICE_CYCLES = 20000; // ~30 us at 700 MHz per slice
+constexpr uint32_t HEAP_CHECK_INTERVAL_MS = 100;    // pause between full passes
+
+// Owner id for allocations not belonging to any task
+constexpr uint32_t OWNER_KERNEL = 0;
+
 #if ENABLE_ALLOCATION_TRACKER
 // Allocations
 struct Allocation {
@@ -37,11 +104,27 @@ void init();
 // Get memory usage statistics
 void getStats(MemoryRegion &flash, MemoryRegion &ram, MemoryRegion &heap);
 
+// Per-region and per-section breakdown from the linker symbols, returns the number of entries
+size_t getRegions(RegionInfo *regions, size_t max);
+size_t getSections(SectionInfo *sections, size_t max);
+void printMemoryMap();
+
 // Override malloc/free to track dynamic allocations
 void *malloc(size_t size, const char *file = nullptr, uint32_t line = 0);
 void free(void *ptr, const char *file = nullptr, uint32_t line = 0);
 void *realloc(void *ptr, size_t size, const char *file = nullptr, uint32_t line = 0);
 
+// Ownership of tracked allocations
+uint32_t currentOwner();
+void setOwner(void *ptr, uint32_t owner);
+size_t getOwnerUsage(uint32_t owner);
+size_t freeOwnedBy(uint32_t owner);
+
+// Heap integrity checks, corruption is reported as ErrorCode::MEMORY_CORRUPTION
+// with the allocation site of the damaged block
+bool verifySlice(uint32_t cycleBudget);
+void integrityTask();
+
 #if ENABLE_ALLOCATION_TRACKER
 // Print active allocations
 void printAllocations();
@@ -49,6 +132,9 @@ void printAllocations();
 
 // Heap tracking
 extern MemoryRegion heap;
+extern BlockHeader *blocks;
+extern BlockHeader *checkCursor;
+extern uint32_t checkPasses;
 
 #if ENABLE_ALLOCATION_TRACKER
 // Allocation tracking
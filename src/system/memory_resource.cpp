@@ -0,0 +1,66 @@
+#include "memory_resource.hpp"
+
+#include "error/handler.hpp"
+#include "stm32h7xx.h"
+
+// Function local statics so containers constructed during static init can already use them
+std::pmr::memory_resource *Memory::kernelHeapResource() {
+  static HeapResource kernelHeap(true);
+  return &kernelHeap;
+}
+
+std::pmr::memory_resource *Memory::taskHeapResource() {
+  static HeapResource taskHeap(false);
+  return &taskHeap;
+}
+
+void *Memory::HeapResource::do_allocate(size_t bytes, size_t alignment) {
+  if (alignment > MAX_ALIGN) {
+    ErrorHandler::handle(ErrorCode::MEMORY_ALLOCATION_FAILED, __FILE__, __LINE__);
+    return nullptr;
+  }
+
+  void *ptr = Memory::malloc(bytes, __FILE__, __LINE__);
+  if (!ptr) {
+    ErrorHandler::handle(ErrorCode::MEMORY_ALLOCATION_FAILED, __FILE__, __LINE__);
+    return nullptr;
+  }
+
+  if (kernel)
+    Memory::setOwner(ptr, OWNER_KERNEL);
+  return ptr;
+}
+
+void Memory::HeapResource::do_deallocate(void *p, size_t bytes, size_t alignment) { Memory::free(p, __FILE__, __LINE__); }
+
+bool Memory::HeapResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+  // Both shared heap resources free through Memory::free, so memory from one can go back to the other
+  auto shared = [](const std::pmr::memory_resource *r) { return r == kernelHeapResource() || r == taskHeapResource(); };
+  return this == &other || (shared(this) && shared(&other));
+}
+
+void *Memory::ArenaResource::do_allocate(size_t bytes, size_t alignment) {
+  // Align the address, the buffer itself may be less aligned than the request
+  uintptr_t base = reinterpret_cast<uintptr_t>(buffer);
+  size_t start = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+  if (start > size || bytes > size - start) {
+    ErrorHandler::handle(ErrorCode::MEMORY_ALLOCATION_FAILED, __FILE__, __LINE__);
+    return nullptr;
+  }
+
+  offset = start + bytes;
+  return buffer + start;
+}
+
+uint32_t Memory::poolLock() {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+void Memory::poolUnlock(uint32_t primask) { __set_PRIMASK(primask); }
+
+void *Memory::poolExhausted() {
+  ErrorHandler::handle(ErrorCode::MEMORY_ALLOCATION_FAILED, __FILE__, __LINE__);
+  return nullptr;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "memory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace Memory {
+// Largest alignment the tracked heap guarantees (BlockHeader is 8 byte aligned)
+constexpr size_t MAX_ALIGN = alignof(BlockHeader);
+
+// memory_resource over Memory::malloc/free, so pmr containers show up in the heap stats.
+// Kernel resources tag their blocks with OWNER_KERNEL so they survive the exit of the
+// task that happened to allocate them, task resources belong to the allocating task.
+class HeapResource : public std::pmr::memory_resource {
+public:
+  explicit HeapResource(bool kernel) : kernel(kernel) {}
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+  bool kernel;
+};
+
+// Bump allocator over a fixed buffer, deallocate is a no-op and release() frees everything.
+// Does not fall back to the heap when the buffer is exhausted.
+class ArenaResource : public std::pmr::memory_resource {
+public:
+  ArenaResource(void *buffer, size_t size) : buffer(static_cast<uint8_t *>(buffer)), size(size), offset(0) {}
+
+  void release() { offset = 0; }
+  size_t used() const { return offset; }
+  size_t capacity() const { return size; }
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {}
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+  uint8_t *buffer;
+  size_t size;
+  size_t offset;
+};
+
+// Helpers for PoolResource, kept out of line to avoid pulling HAL headers in here
+uint32_t poolLock();
+void poolUnlock(uint32_t primask);
+void *poolExhausted();
+
+// Fixed block pool with an intrusive free list, allocations up to BlockSize bytes take
+// one block in constant time and never touch the heap
+template <size_t BlockSize, size_t BlockCount> class PoolResource : public std::pmr::memory_resource {
+  static_assert(BlockSize >= sizeof(void *), "BlockSize must hold a free list pointer");
+  static constexpr size_t STRIDE = (BlockSize + MAX_ALIGN - 1) & ~(MAX_ALIGN - 1);
+
+public:
+  PoolResource() : freeList(nullptr), freeCount(BlockCount) {
+    for (size_t i = BlockCount; i > 0; i--) {
+      void *block = storage + (i - 1) * STRIDE;
+      *static_cast<void **>(block) = freeList;
+      freeList = block;
+    }
+  }
+
+  size_t available() const { return freeCount; }
+  size_t capacity() const { return BlockCount; }
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    if (bytes > BlockSize || alignment > MAX_ALIGN)
+      return poolExhausted();
+
+    uint32_t primask = poolLock();
+    void *block = freeList;
+    if (block) {
+      freeList = *static_cast<void **>(block);
+      freeCount--;
+    }
+    poolUnlock(primask);
+
+    return block ? block : poolExhausted();
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    if (!p)
+      return;
+
+    uint32_t primask = poolLock();
+    *static_cast<void **>(p) = freeList;
+    freeList = p;
+    freeCount++;
+    poolUnlock(primask);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+  alignas(MAX_ALIGN) uint8_t storage[STRIDE * BlockCount];
+  void *freeList;
+  size_t freeCount;
+};
+
+// Shared heap resources, taskHeapResource is installed as the pmr default resource
+std::pmr::memory_resource *kernelHeapResource();
+std::pmr::memory_resource *taskHeapResource();
+} // namespace Memory
@@ -1,19 +1,30 @@
 #include "scheduler.hpp"
 
+#include "error/handler.hpp"
 #include "memory.hpp"
+#include "stdout.hpp"
 #include "stm32h7xx_hal.h"
 
 #include <cstdio>
 #include <cstring>
 
 namespace Scheduler {
-// initialize variables
-uint32_t taskCount = 0;
-TCB *tasks = nullptr;
-TCB *currentTask = nullptr;
-TCB *nextTask = nullptr;
-uint32_t taskIndex = 0;
-bool active = false;
+// initialize variables, everything touched on a context switch lives in DTCM
+DTCM_BSS uint32_t taskCount = 0;
+DTCM_BSS TCB taskTable[MAX_TASKS];
+DTCM_BSS TCB *tasks = nullptr;
+DTCM_BSS TCB *currentTask = nullptr;
+DTCM_BSS TCB *nextTask = nullptr;
+DTCM_BSS uint32_t taskIndex = 0;
+DTCM_BSS bool active = false;
+DTCM_BSS uint32_t switchStart = 0;
+DTCM_BSS uint32_t switchCycles = 0;
+DTCM_BSS uint32_t switchCyclesMax = 0;
+DTCM_BSS uint32_t runCycles[MAX_TASKS];
+DTCM_BSS uint32_t lastSwitch = 0;
+DTCM_BSS TraceEntry trace[TRACE_SIZE];
+DTCM_BSS uint32_t traceIndex = 0;
+uint32_t nextTaskId = 1; // 0 is reserved for Memory::OWNER_KERNEL
 uint32_t tasksInYieldDelay = 0;
 uint32_t lastIdleCheckTime = 0;
 uint32_t windowStartTime = 0;
@@ -21,25 +32,28 @@ uint32_t windowIdleTime = 0;
 uint32_t windowTotalTime = 0;
 } // namespace Scheduler
 
-void Scheduler::initTaskStack(void (*task)(void), uint32_t stackSize, const char *name) {
+uint32_t Scheduler::initTaskStack(void (*task)(void), uint32_t stackSize, const char *name) {
   __disable_irq();
-  // Allocate one task if none exist
-  if (tasks == nullptr) {
-    tasks = (TCB *)Memory::malloc(sizeof(TCB), __FILE__, __LINE__);
-    memset(tasks, 0, sizeof(TCB));
-  } else {
-    // Reallocate tasks array
-    tasks = (TCB *)Memory::realloc(tasks, (taskCount + 1) * sizeof(TCB), __FILE__, __LINE__);
-    // only memset the new task
-    memset(&tasks[taskCount], 0, sizeof(TCB));
+  if (taskCount >= MAX_TASKS) {
+    __enable_irq();
+    ErrorHandler::handle(ErrorCode::TASK_SCHEDULING_ERROR, __FILE__, __LINE__);
+    return 0;
   }
 
+  // TCBs live in the static table, tasks stays nullptr until the first task exists
+  tasks = taskTable;
+  memset(&tasks[taskCount], 0, sizeof(TCB));
+  runCycles[taskCount] = 0;
+
   taskCount++;
 
   // Allocate stack for new task
   TCB *newTask = &tasks[taskCount - 1];
   newTask->stackBase = (uint32_t *)Memory::malloc(stackSize * sizeof(uint32_t), __FILE__, __LINE__);
-  memset(newTask->stackBase, 0, stackSize * sizeof(uint32_t));
+  // Stacks must not be reclaimed when the creating task exits
+  Memory::setOwner(newTask->stackBase, Memory::OWNER_KERNEL);
+  for (uint32_t i = 0; i < stackSize; i++)
+    newTask->stackBase[i] = STACK_FILL;
   newTask->stackPointer = newTask->stackBase + stackSize;
 
   // push task context
@@ -61,35 +75,45 @@ void Scheduler::initTaskStack(void (*task)(void), uint32_t stackSize, const char
     strncpy(newTask->name, name, sizeof(newTask->name));
   }
 
+  // assign task id
+  newTask->id = nextTaskId++;
+
   // set task ready
   newTask->state = TaskState::READY;
 
+  uint32_t id = newTask->id;
   __enable_irq();
+  return id;
 }
 
 void Scheduler::taskExit() {
+  // Still running as the exiting task, push out whatever it left in its stdout buffer
+  Stdout::release();
+
   __disable_irq();
   // Set the task to TERMINATED
   currentTask->state = TaskState::TERMINATED;
 
+  // Save what is needed for cleanup before the TCB gets overwritten
+  uint32_t *stackBase = currentTask->stackBase;
+  uint32_t id = currentTask->id;
+  uint32_t index = currentTask - tasks;
+
   // Move all tasks after current task one position back
-  for (int i = taskIndex; i < taskCount; i++) {
+  for (uint32_t i = index + 1; i < taskCount; i++) {
     memcpy(&tasks[i - 1], &tasks[i], sizeof(TCB));
+    runCycles[i - 1] = runCycles[i];
   }
 
-  // Free currentTask's stack
-  Memory::free(currentTask->stackBase, __FILE__, __LINE__);
-
-  // reallocate tasks array to new size
-  tasks = (TCB *)Memory::realloc(tasks, (taskCount - 1) * sizeof(TCB), __FILE__, __LINE__);
+  // Free currentTask's stack and everything it still owns on the heap
+  Memory::free(stackBase, __FILE__, __LINE__);
+  Memory::freeOwnedBy(id);
 
   // Decrement taskCount
   taskCount--;
 
-  // decrement taskIndex if not 0
-  if (taskIndex != 0) {
-    taskIndex--;
-  }
+  // continue with the task that moved into the freed slot
+  taskIndex = taskCount ? index % taskCount : 0;
 
   // update currentTask pointer to nullptr
   currentTask = nullptr;
@@ -117,6 +141,27 @@ void Scheduler::yieldDelay(uint32_t ms) {
   }
 }
 
+// Charge the time since the last switch to the outgoing task, called from PendSV
+void Scheduler::accountSwitch() {
+  uint32_t now = switchStart;
+  if (currentTask != nullptr) {
+    runCycles[currentTask - tasks] += now - lastSwitch;
+    TraceEntry &entry = trace[traceIndex % TRACE_SIZE];
+    entry.cycles = now;
+    entry.id = currentTask->id;
+    traceIndex++;
+  }
+  lastSwitch = now;
+}
+
+// Words at the bottom of the stack that were never written
+uint32_t Scheduler::stackFree(const TCB &task) {
+  uint32_t words = 0;
+  while (&task.stackBase[words] < task.stackPointer && task.stackBase[words] == STACK_FILL)
+    words++;
+  return words;
+}
+
 void Scheduler::updateNextTask() {
   uint32_t startIndex = taskIndex;
   // find next ready task or continue with current task
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "tcm.hpp"
+
 #include <cstdint>
 
 // Task state enum
@@ -11,6 +13,7 @@ struct TCB {
   uint32_t *stackBase;
   TaskState state;
   char name[16];
+  uint32_t id; // unique task id, used as owner tag for heap allocations
 } __attribute__((aligned(32)));
 
 // Scheduler namespace
@@ -18,10 +21,13 @@ namespace Scheduler {
 // Scheduler variables
 extern uint32_t taskCount;
 constexpr uint32_t TCB_SIZE = sizeof(TCB);
+constexpr uint32_t MAX_TASKS = 16;    // size of the static TCB table in DTCM
+extern TCB taskTable[MAX_TASKS];
 extern TCB *tasks;
 extern TCB *currentTask;
 extern TCB *nextTask;
 extern bool active;
+extern uint32_t nextTaskId;
 constexpr uint32_t IDLE_WINDOW_MS = 4000; // 4 second window
 extern uint32_t tasksInYieldDelay;        // Number of tasks currently in yieldDelay
 extern uint32_t lastIdleCheckTime;        // Last time we checked for idle state
@@ -29,11 +35,34 @@ extern uint32_t windowStartTime;          // Start of the measurement window
 extern uint32_t windowIdleTime;           // Idle time within current window
 extern uint32_t windowTotalTime;          // Total time within current window
 
+// Context switch timing in core cycles, from PendSV entry to the restored context
+extern uint32_t switchStart;
+extern uint32_t switchCycles;
+extern uint32_t switchCyclesMax;
+
+// Run time per task slot in core cycles, wraps, compare two samples less than a lap apart
+extern uint32_t runCycles[MAX_TASKS];
+extern uint32_t lastSwitch;
+
+// Ring of the last context switches: when the switch happened and which task it ended
+struct TraceEntry {
+  uint32_t cycles;
+  uint32_t id;
+};
+constexpr uint32_t TRACE_SIZE = 64;
+extern TraceEntry trace[TRACE_SIZE];
+extern uint32_t traceIndex;
+
+// Task stacks are filled with this at creation, untouched words give the watermark
+constexpr uint32_t STACK_FILL = 0xA5A5A5A5;
+
 void start();
 void yield();
-void initTaskStack(void (*task)(void), uint32_t stackSize, const char *name = nullptr);
+uint32_t initTaskStack(void (*task)(void), uint32_t stackSize, const char *name = nullptr);
 void taskExit();
-void updateNextTask();
+ITCM_FUNC void updateNextTask();
+ITCM_FUNC void accountSwitch();
+uint32_t stackFree(const TCB &task);
 void switchTasks();
 void yieldDelay(uint32_t ms);
 
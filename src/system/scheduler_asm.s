@@ -11,6 +11,10 @@
 .global _ZN9Scheduler5yieldEv
 .type _ZN9Scheduler5yieldEv, %function
 
+// yield and switchTasks run on every context switch, they are copied to ITCM at startup
+.section .itcm_text.scheduler,"ax",%progbits
+.align 2
+
 _ZN9Scheduler5yieldEv:
   // check if scheduler is active
   LDR r0, =_ZN9Scheduler6activeE
@@ -26,6 +30,8 @@ _ZN9Scheduler5yieldEv:
 yield_exit:
   BX LR
 
+.text
+
 _ZN9Scheduler5startEv:
   // Check if tasks is nullptr
   LDR r0, =_ZN9Scheduler5tasksE
@@ -72,6 +78,9 @@ _ZN9Scheduler5startEv:
 start_exit:
   BX LR
 
+.section .itcm_text.scheduler,"ax",%progbits
+.align 2
+
 _ZN9Scheduler11switchTasksEv:
   // disable interrupts
   CPSID I
@@ -109,6 +118,20 @@ skip_context_save:
   // Instruction syncronization barrier
   ISB
 
+  // record context switch duration (DWT->CYCCNT - switchStart)
+  LDR r0, =0xE0001004
+  LDR r0, [r0]
+  LDR r1, =_ZN9Scheduler11switchStartE
+  LDR r1, [r1]
+  SUB r0, r0, r1
+  LDR r1, =_ZN9Scheduler12switchCyclesE
+  STR r0, [r1]
+  LDR r1, =_ZN9Scheduler15switchCyclesMaxE
+  LDR r2, [r1]
+  CMP r0, r2
+  IT HI
+  STRHI r0, [r1]
+
   // restore interrupts
   CPSIE I
   
@@ -0,0 +1,585 @@
+#include "shell.hpp"
+
+#include "../peripherals/spi.hpp"
+#include "../peripherals/uart.hpp"
+#include "cycles.hpp"
+#include "memory.hpp"
+#include "scheduler.hpp"
+#include "stdout.hpp"
+#include "systick.hpp"
+
+#if ENABLE_LCD
+#include "../peripherals/blitter.hpp"
+#include "../peripherals/frame.hpp"
+#include "../peripherals/image.hpp"
+#include "../peripherals/lcd.hpp"
+#include "../peripherals/lines.hpp"
+#include "../peripherals/tiles.hpp"
+#endif
+#if ENABLE_MICROSD
+#include "../peripherals/microsd.hpp"
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void cmdHelp(int argc, char **argv);
+static void cmdPs(int argc, char **argv);
+static void cmdHeap(int argc, char **argv);
+static void cmdTraceDump(int argc, char **argv);
+static void cmdPerf(int argc, char **argv);
+static void cmdUartBaud(int argc, char **argv);
+static void cmdUartBench(int argc, char **argv);
+static void cmdSpiStats(int argc, char **argv);
+
+#if ENABLE_MICROSD
+static void cmdSdBench(int argc, char **argv);
+#endif
+#if ENABLE_LCD && ENABLE_MICROSD && ENABLE_FATFS
+static void cmdImageBench(int argc, char **argv);
+#endif
+
+#if ENABLE_LCD
+static void cmdLcdFps(int argc, char **argv);
+static void cmdLcdFrames(int argc, char **argv);
+static void cmdLcdBench(int argc, char **argv);
+static void cmdLcdText(int argc, char **argv);
+#endif
+
+namespace Shell {
+const Command commands[] = {
+    {"help", "list commands", cmdHelp},
+    {"ps", "tasks with state, CPU load and free stack", cmdPs},
+    {"heap", "heap usage per owner", cmdHeap},
+    {"trace dump", "last context switches", cmdTraceDump},
+    {"perf", "scheduler, UART and stdout counters", cmdPerf},
+    {"uart baud", "show or set the console baud rate", cmdUartBaud},
+    {"uart bench", "loopback throughput [baud] [ms]", cmdUartBench},
+    {"spi stats", "bus utilization, transfers and queue depth per second", cmdSpiStats},
+#if ENABLE_MICROSD
+    {"sd bench", "raw block read throughput", cmdSdBench},
+#endif
+#if ENABLE_LCD && ENABLE_MICROSD && ENABLE_FATFS
+    {"image bench", "RLE/QOI image decode throughput in MB/s <file> [runs]", cmdImageBench},
+#endif
+#if ENABLE_LCD
+    {"lcd fps", "frames and bytes sent to the display per second", cmdLcdFps},
+    {"lcd frames", "frame pacing and render/transfer histograms [rate|reset]", cmdLcdFrames},
+    {"lcd bench", "fill, blit, blend, swap, line and trace cycles, CPU vs DMA2D", cmdLcdBench},
+    {"lcd text", "glyph atlas text rendering in chars/ms", cmdLcdText},
+#endif
+};
+constexpr uint32_t COMMAND_COUNT = sizeof(commands) / sizeof(commands[0]);
+} // namespace Shell
+
+static const char *stateName(TaskState state) {
+  switch (state) {
+  case TaskState::READY:
+    return "ready";
+  case TaskState::RUNNING:
+    return "running";
+  case TaskState::SUSPENDED:
+    return "suspended";
+  case TaskState::TERMINATED:
+    return "terminated";
+  default:
+    return "uninit";
+  }
+}
+
+static void cmdHelp(int argc, char **argv) {
+  for (const Shell::Command &command : Shell::commands)
+    printf("  %-12s %s\n", command.name, command.help);
+}
+
+static void cmdPs(int argc, char **argv) {
+  // Sample run time over a short window, matched by id in case tasks come and go
+  uint32_t ids[Scheduler::MAX_TASKS];
+  uint32_t before[Scheduler::MAX_TASKS];
+  uint32_t count = Scheduler::taskCount;
+  for (uint32_t i = 0; i < count; i++) {
+    ids[i] = Scheduler::tasks[i].id;
+    before[i] = Scheduler::runCycles[i];
+  }
+  uint32_t start = Cycles::now();
+  Scheduler::yieldDelay(500);
+  uint32_t window = Cycles::since(start);
+
+  printf("  ID NAME             STATE       CPU  FREE STACK\n");
+  for (uint32_t i = 0; i < Scheduler::taskCount; i++) {
+    const TCB &task = Scheduler::tasks[i];
+    uint32_t load = 0;
+    for (uint32_t j = 0; j < count; j++) {
+      if (ids[j] == task.id) {
+        load = (uint64_t)(Scheduler::runCycles[i] - before[j]) * 1000 / window;
+        break;
+      }
+    }
+    printf("%4lu %-16.16s %-10s %3lu.%lu%% %6lu B\n", task.id, task.name, stateName(task.state), load / 10, load % 10,
+           Scheduler::stackFree(task) * sizeof(uint32_t));
+  }
+}
+
+static void cmdHeap(int argc, char **argv) {
+  Memory::MemoryRegion flash, ram, heap;
+  Memory::getStats(flash, ram, heap);
+  printf("heap %lu / %lu B\n", heap.used, heap.size);
+  printf("  %-16s %lu B\n", "kernel", Memory::getOwnerUsage(Memory::OWNER_KERNEL));
+  for (uint32_t i = 0; i < Scheduler::taskCount; i++)
+    printf("  %-16.16s %lu B\n", Scheduler::tasks[i].name, Memory::getOwnerUsage(Scheduler::tasks[i].id));
+#if ENABLE_HEAP_CHECK
+  printf("integrity passes %lu\n", Memory::checkPasses);
+#endif
+#if ENABLE_ALLOCATION_TRACKER
+  Memory::printAllocations();
+#endif
+}
+
+static void cmdTraceDump(int argc, char **argv) {
+  // Copy first, the ring keeps moving while we print. Static, the shell stack is only 2 KB
+  static Scheduler::TraceEntry entries[Scheduler::TRACE_SIZE];
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t end = Scheduler::traceIndex;
+  memcpy(entries, Scheduler::trace, sizeof(entries));
+  __set_PRIMASK(primask);
+
+  uint32_t count = end < Scheduler::TRACE_SIZE ? end : Scheduler::TRACE_SIZE;
+  uint32_t previous = 0;
+  printf("  switch        cycles   delta us  task\n");
+  for (uint32_t n = end - count; n != end; n++) {
+    const Scheduler::TraceEntry &entry = entries[n % Scheduler::TRACE_SIZE];
+    uint32_t delta = n == end - count ? 0 : Cycles::toMicros(entry.cycles - previous);
+    previous = entry.cycles;
+
+    const char *name = "?";
+    for (uint32_t i = 0; i < Scheduler::taskCount; i++) {
+      if (Scheduler::tasks[i].id == entry.id)
+        name = Scheduler::tasks[i].name;
+    }
+    printf("%8lu %12lu %10lu  %lu %.16s\n", n, entry.cycles, delta, entry.id, name);
+  }
+}
+
+static void cmdPerf(int argc, char **argv) {
+  printf("context switch %lu cycles (max %lu)\n", Scheduler::switchCycles, Scheduler::switchCyclesMax);
+  printf("systick entry  %lu cycles (max %lu)\n", SystemTick::entryCycles, SystemTick::entryCyclesMax);
+
+  UART::TxStats tx = UART::getTxStats();
+  printf("uart tx queued %lu sent %lu dropped %lu overwritten %lu transfers %lu blocked %lu irq %lu cycles\n",
+         tx.bytesQueued, tx.bytesSent, tx.bytesDropped, tx.bytesOverwritten, tx.transfers, tx.blockedWrites,
+         tx.irqCycles);
+  UART::RxStats rx = UART::getRxStats();
+  printf("uart rx received %lu read %lu overruns %lu events %lu errors %lu irq %lu cycles\n", rx.bytesReceived,
+         rx.bytesRead, rx.overruns, rx.events, rx.errors, rx.irqCycles);
+
+  Stdout::Stats out = Stdout::getStats();
+  printf("stdout writes %lu flushes %lu bytes %lu cycles %lu\n", out.writes, out.flushes, out.bytes, out.cycles);
+}
+
+static void cmdUartBaud(int argc, char **argv) {
+  if (argc < 2) {
+    printf("%lu baud\n", UART::getBaudRate());
+    return;
+  }
+
+  uint32_t baud = strtoul(argv[1], nullptr, 10);
+  printf("switching to %lu baud\n", baud);
+  // configure() drains the ring first, so this line still goes out at the old rate
+  Stdout::flush();
+  if (!UART::configure(baud))
+    printf("%lu baud is out of range (max %lu) or too far off the USART clock\n", baud, UART::MAX_BAUD_RATE);
+}
+
+static void cmdUartBench(int argc, char **argv) {
+  uint32_t baud = argc >= 2 ? strtoul(argv[1], nullptr, 10) : UART::getBaudRate();
+  uint32_t ms = argc >= 3 ? strtoul(argv[2], nullptr, 10) : 1000;
+  if (ms == 0 || ms > 5000)
+    ms = 1000; // keep the window well inside one wrap of the cycle counter
+
+  uint32_t consoleBaud = UART::getBaudRate();
+  printf("loopback at %lu baud for %lu ms, console output is garbled meanwhile\n", baud, ms);
+  Stdout::flush();
+  if (!UART::configure(baud, true)) {
+    printf("%lu baud is out of range (max %lu) or too far off the USART clock\n", baud, UART::MAX_BAUD_RATE);
+    return;
+  }
+
+  // Keep the ring topped up in blocks and drain the receiver, yield only when neither
+  // side has work. Other tasks' output is counted too, the line does not care.
+  constexpr uint32_t BLOCK = 512;
+  static char pattern[BLOCK];
+  static char input[BLOCK];
+  for (uint32_t i = 0; i < BLOCK; i++)
+    pattern[i] = 'A' + i % 26;
+
+  UART::TxStats txBefore = UART::getTxStats();
+  UART::RxStats rxBefore = UART::getRxStats();
+  uint32_t window = ms * (SystemCoreClock / 1000);
+  uint32_t threadCycles = 0;
+  uint32_t received = 0;
+  uint32_t start = Cycles::now();
+
+  while (Cycles::since(start) < window) {
+    bool idle = true;
+    uint32_t t = Cycles::now();
+    if (UART::txFree() >= BLOCK) {
+      UART::write(pattern, BLOCK);
+      idle = false;
+    }
+    int count = UART::read(input, sizeof(input), 0);
+    threadCycles += Cycles::since(t);
+    if (count > 0) {
+      received += count;
+      idle = false;
+    }
+    if (idle)
+      Scheduler::yield();
+  }
+  uint32_t elapsed = Cycles::since(start);
+
+  UART::TxStats txAfter = UART::getTxStats();
+  UART::RxStats rxAfter = UART::getRxStats();
+  // Let what is still on the line arrive so it is not mistaken for loss
+  uint32_t settle = HAL_GetTick();
+  while (HAL_GetTick() - settle < 20) {
+    int count = UART::read(input, sizeof(input), 1);
+    if (count > 0)
+      received += count;
+  }
+
+  UART::configure(consoleBaud);
+
+  uint32_t sent = txAfter.bytesSent - txBefore.bytesSent;
+  uint32_t micros = Cycles::toMicros(elapsed);
+  uint32_t irqCycles = (txAfter.irqCycles - txBefore.irqCycles) + (rxAfter.irqCycles - rxBefore.irqCycles);
+  uint32_t load = (uint64_t)(threadCycles + irqCycles) * 1000 / elapsed;
+  printf("sent %lu B, %lu B/s, line limit %lu B/s\n", sent, (uint32_t)((uint64_t)sent * 1000000 / micros),
+         baud / 10);
+  printf("received %lu B, overruns %lu, errors %lu\n", received, rxAfter.overruns - rxBefore.overruns,
+         rxAfter.errors - rxBefore.errors);
+  printf("cpu %lu.%lu%% (thread %lu us, irq %lu us)\n", load / 10, load % 10, Cycles::toMicros(threadCycles),
+         Cycles::toMicros(irqCycles));
+}
+
+static void cmdSpiStats(int argc, char **argv) {
+  SPI::Stats before = SPI::getStats();
+  uint32_t start = Cycles::now();
+  Scheduler::yieldDelay(1000);
+  uint32_t elapsed = Cycles::since(start);
+  SPI::Stats after = SPI::getStats();
+
+  uint32_t load = (uint64_t)(after.busyCycles - before.busyCycles) * 1000 / elapsed;
+  printf("bus busy %lu.%lu%% over %lu ms\n", load / 10, load % 10, Cycles::toMicros(elapsed) / 1000);
+  printf("%lu transactions, %lu transfers, %lu B\n", after.transactions - before.transactions,
+         after.transfers - before.transfers, after.bytes - before.bytes);
+  printf("since boot: errors %lu, stalls %lu, queue peak high %u normal %u of %u\n", after.errors, after.stalls,
+         after.peak[(uint8_t)SPI::Priority::HIGH], after.peak[(uint8_t)SPI::Priority::NORMAL], SPI::QUEUE_SIZE);
+}
+
+#if ENABLE_MICROSD
+static void cmdSdBench(int argc, char **argv) {
+  if (!MicroSD::available()) {
+    printf("card not available\n");
+    return;
+  }
+
+  constexpr uint32_t CHUNK_BLOCKS = 32; // 16 KB per read
+  constexpr uint32_t CHUNKS = 16;
+  uint8_t *buffer = (uint8_t *)Memory::malloc(CHUNK_BLOCKS * 512, __FILE__, __LINE__);
+  if (buffer == nullptr) {
+    printf("out of memory\n");
+    return;
+  }
+
+  // Reads run with interrupts off, time them with the cycle counter instead of the tick
+  uint64_t cycles = 0;
+  for (uint32_t i = 0; i < CHUNKS; i++) {
+    uint32_t start = Cycles::now();
+    MicroSD::readBlocks(buffer, i * CHUNK_BLOCKS, CHUNK_BLOCKS, 1000);
+    cycles += Cycles::since(start);
+    Scheduler::yield();
+  }
+  Memory::free(buffer, __FILE__, __LINE__);
+
+  uint32_t bytes = CHUNKS * CHUNK_BLOCKS * 512;
+  uint32_t micros = cycles / (SystemCoreClock / 1000000);
+  uint32_t rate = micros ? (uint64_t)bytes * 1000000 / 1024 / micros : 0;
+  printf("read %lu KB in %lu us, %lu KB/s\n", bytes / 1024, micros, rate);
+}
+#endif
+
+#if ENABLE_LCD
+#if ENABLE_MICROSD && ENABLE_FATFS
+// Prints bytes over microseconds as MB/s with two decimals
+static void printRate(const char *what, uint32_t bytes, uint32_t micros) {
+  uint32_t rate = micros ? (uint64_t)bytes * 100 / micros : 0;
+  printf("%s %lu us, %lu.%02lu MB/s\n", what, micros, rate / 100, rate % 100);
+}
+
+static void cmdImageBench(int argc, char **argv) {
+  if (argc < 2) {
+    printf("usage: image bench <file> [runs]\n");
+    return;
+  }
+  uint32_t runs = argc >= 3 ? strtoul(argv[2], nullptr, 10) : 10;
+  if (runs == 0 || runs > 1000)
+    runs = 10;
+
+  static FILINFO info;
+  if (FatFs::getFileInfo(argv[1], &info) != FR_OK) {
+    printf("cannot open %s\n", argv[1]);
+    return;
+  }
+  uint32_t size = info.fsize;
+  uint8_t *data = (uint8_t *)Memory::malloc(size, __FILE__, __LINE__);
+  if (data == nullptr) {
+    printf("out of memory\n");
+    return;
+  }
+
+  uint32_t length = 0;
+  uint32_t start = Cycles::now();
+  FRESULT res = Image::load(argv[1], data, size, &length);
+  uint32_t loadMicros = Cycles::toMicros(Cycles::since(start));
+  Image::Header header;
+  if (res != FR_OK || !Image::parse(data, length, header)) {
+    printf("%s is not an image\n", argv[1]);
+    Memory::free(data, __FILE__, __LINE__);
+    return;
+  }
+
+  // Decode into a scratch canvas of the image's size, the LCD is left alone
+  uint32_t pixelBytes = header.width * header.height * 2;
+  uint16_t *scratch = (uint16_t *)Memory::malloc(pixelBytes, __FILE__, __LINE__);
+  if (scratch == nullptr) {
+    printf("out of memory\n");
+    Memory::free(data, __FILE__, __LINE__);
+    return;
+  }
+  Text::Canvas canvas = {scratch, header.width, 0, 0, header.width, header.height};
+  start = Cycles::now();
+  for (uint32_t i = 0; i < runs; i++)
+    Image::decode(canvas, 0, 0, data);
+  uint32_t decodeMicros = Cycles::toMicros(Cycles::since(start)) / runs;
+  Memory::free(scratch, __FILE__, __LINE__);
+  Memory::free(data, __FILE__, __LINE__);
+
+  static const char *const formats[] = {"raw", "rle", "qoi"};
+  printf("%s: %ux%u %s%s, %lu B stream for %lu B of pixels\n", argv[1], header.width, header.height,
+         formats[(uint8_t)header.format], header.flags & Image::FLAG_TRANSPARENT ? " sprite" : "", header.size,
+         pixelBytes);
+  printRate("sd read", length, loadMicros);
+  printRate("decode out", pixelBytes, decodeMicros);
+  printRate("decode in ", header.size, decodeMicros);
+#if !ENABLE_LCD_TILES
+  // Streamed through the chunk buffer, reads and decoding together
+  start = Cycles::now();
+  Image::drawFile(argv[1], 0, 0);
+  printRate("streamed to framebuffer", pixelBytes, Cycles::toMicros(Cycles::since(start)));
+#endif
+}
+#endif
+
+static void cmdLcdFps(int argc, char **argv) {
+  uint32_t frames = LCD::frameCount;
+  uint32_t bytes = LCD::bytesSent;
+  uint32_t start = Cycles::now();
+  Scheduler::yieldDelay(1000);
+  uint32_t micros = Cycles::toMicros(Cycles::since(start));
+  uint32_t count = LCD::frameCount - frames;
+  bytes = LCD::bytesSent - bytes;
+  printf("%lu frames in %lu ms, %lu.%lu fps\n", count, micros / 1000, count * 1000000 / micros,
+         (count * 10000000 / micros) % 10);
+  printf("%lu B sent, %lu B per frame (full frame %u B)\n", bytes, count ? bytes / count : 0,
+         LCD::FRAMEBUFFER_SIZE);
+#if ENABLE_LCD_TILES
+  printf("display list peak %u of %u commands, %lu dropped\n", Tiles::commandPeak, Tiles::MAX_COMMANDS,
+         Tiles::dropped);
+#endif
+}
+#endif
+
+#if ENABLE_LCD
+static void printHistogram(const char *name, const Frame::Histogram &histogram) {
+  printf("%s: %lu frames, avg %lu us, max %lu us\n", name, histogram.count,
+         histogram.count ? (uint32_t)(histogram.total / histogram.count) : 0, histogram.max);
+  for (uint8_t i = 0; i < Frame::HISTOGRAM_BINS; i++) {
+    if (histogram.bins[i] == 0)
+      continue;
+    if (Frame::binLimit(i))
+      printf("  < %5lu us %lu\n", Frame::binLimit(i), histogram.bins[i]);
+    else
+      printf("  >=%5lu us %lu\n", Frame::binLimit(i - 1), histogram.bins[i]);
+  }
+}
+
+static void cmdLcdFrames(int argc, char **argv) {
+  if (argc >= 2) {
+    if (strcmp(argv[1], "reset") == 0)
+      Frame::resetStats();
+    else
+      Frame::setTargetRate(strtoul(argv[1], nullptr, 10));
+  }
+
+  Frame::Stats stats = Frame::getStats();
+  printf("target %lu Hz, measured %lu.%lu Hz, %lu frames, %lu slots skipped\n", stats.targetRate,
+         stats.rate10 / 10, stats.rate10 % 10, stats.frames, stats.skipped);
+  printHistogram("render", stats.render);
+  printHistogram("transfer", stats.transfer);
+}
+#endif
+
+#if ENABLE_LCD
+// Average cycles of one blitter call on the given backend
+template <typename Op> static uint32_t timeBlit(Blitter::Backend backend, Op op) {
+  constexpr uint32_t RUNS = 16;
+  Blitter::setBackend(backend);
+  uint32_t start = Cycles::now();
+  for (uint32_t i = 0; i < RUNS; i++)
+    op();
+  uint32_t cycles = Cycles::since(start) / RUNS;
+  Blitter::setBackend(Blitter::Backend::AUTO);
+  return cycles;
+}
+
+template <typename Op> static void benchBlit(const char *name, Op op) {
+  uint32_t cpu = timeBlit(Blitter::Backend::CPU, op);
+  uint32_t dma2d = timeBlit(Blitter::Backend::DMA2D, op);
+  printf("  %-14s %10lu %10lu\n", name, cpu, dma2d);
+}
+
+template <typename Op> static void benchLine(const char *name, Op op) {
+  printf("  %-14s %10lu %10s\n", name, timeBlit(Blitter::Backend::CPU, op), "-");
+}
+
+static void cmdLcdBench(int argc, char **argv) {
+  // Scratch screen and source on the heap, the framebuffer is left alone
+  constexpr uint16_t W = LCD::WIDTH;
+  constexpr uint16_t H = LCD::HEIGHT;
+  uint16_t *screen = (uint16_t *)Memory::malloc(W * H * 2 * sizeof(uint16_t), __FILE__, __LINE__);
+  if (screen == nullptr) {
+    printf("out of memory\n");
+    return;
+  }
+  uint16_t *source = screen + W * H;
+  for (uint32_t i = 0; i < W * H; i++)
+    source[i] = i * 2654435761u >> 16;
+
+  // Without ENABLE_DMA2D both columns run on the CPU
+  printf("  %-14s %10s %10s\n", "cycles", "cpu", "dma2d");
+  benchBlit("clear 160x80", [&] { Blitter::fill(screen, W, W, H, BLACK); });
+  benchBlit("fill 40x20", [&] { Blitter::fill(screen + 7, W, 40, 20, GRAY); });
+  benchBlit("glyph 6x12", [&] { Blitter::copy(screen + 3, W, source, 6, 6, 12); });
+  benchBlit("glyph 8x16", [&] { Blitter::copy(screen + 3, W, source, 8, 8, 16); });
+  benchBlit("copy 160x80", [&] { Blitter::copy(screen, W, source, W, W, H); });
+  benchBlit("blend 160x80", [&] { Blitter::blend(screen, W, source, W, W, H, 128); });
+  benchBlit("swap 160x80", [&] { Blitter::swapBytes(screen, W, source, W, W, H); });
+
+  // Lines and traces run on the CPU only, the samples reuse the source buffer
+  Text::Canvas canvas = {screen, W, 0, 0, W, H};
+  uint8_t *rows = (uint8_t *)source;
+  for (uint32_t i = 0; i < 8 * W; i++)
+    rows[i] %= H;
+  benchLine("line 160x80", [&] { Lines::line(canvas, 0, 0, W - 1, H - 1, WHITE); });
+  benchLine("line clipped", [&] { Lines::line(canvas, -2000, -1000, 2000, 1000, WHITE); });
+  benchLine("trace 160", [&] { Lines::trace(canvas, 0, 0, W, rows, W, WHITE); });
+  benchLine("trace 1280", [&] { Lines::trace(canvas, 0, 0, W, rows, 8 * W, WHITE); });
+
+  Memory::free(screen, __FILE__, __LINE__);
+}
+
+static void cmdLcdText(int argc, char **argv) {
+  constexpr uint32_t RUNS = 64;
+  constexpr uint16_t W = LCD::WIDTH;
+  constexpr uint16_t H = LCD::HEIGHT;
+  uint16_t *pixels = (uint16_t *)Memory::malloc(W * H * sizeof(uint16_t), __FILE__, __LINE__);
+  if (pixels == nullptr) {
+    printf("out of memory\n");
+    return;
+  }
+  Text::Canvas canvas = {pixels, W, 0, 0, W, H};
+  const char *line = "CPU 42% 123456 fps";
+  const uint32_t chars = strlen(line) * (H / 16);
+
+  printf("  %-10s %10s %10s\n", "chars/ms", "changed", "unchanged");
+  const Text::Font *fonts[] = {&Text::FONT_12, &Text::FONT_16};
+  for (const Text::Font *font : fonts) {
+    uint32_t rate[2];
+    for (uint32_t unchanged = 0; unchanged < 2; unchanged++) {
+      Blitter::fill(pixels, W, W, H, BLACK);
+      uint32_t start = Cycles::now();
+      for (uint32_t i = 0; i < RUNS; i++) {
+        // Alternating colours rewrite every pixel, a fixed colour only compares them
+        uint16_t color = unchanged || (i & 1) ? WHITE : YELLOW;
+        for (uint16_t y = 0; y + 16 <= H; y += 16)
+          Text::draw(canvas, 0, y, line, *font, color, BLACK);
+      }
+      uint32_t cycles = Cycles::since(start);
+      rate[unchanged] = (uint64_t)chars * RUNS * (SystemCoreClock / 1000) / cycles;
+    }
+    printf("  %ux%-8u %10lu %10lu\n", font->width, font->height, rate[0], rate[1]);
+  }
+
+  Memory::free(pixels, __FILE__, __LINE__);
+}
+#endif
+
+void Shell::execute(char *line) {
+  char *argv[MAX_ARGS];
+  int argc = 0;
+  for (char *token = strtok(line, " \t"); token && argc < (int)MAX_ARGS; token = strtok(nullptr, " \t"))
+    argv[argc++] = token;
+  if (argc == 0)
+    return;
+
+  for (const Command &command : commands) {
+    // Two word commands match the first two arguments
+    const char *space = strchr(command.name, ' ');
+    if (space == nullptr) {
+      if (strcmp(command.name, argv[0]) == 0) {
+        command.handler(argc, argv);
+        return;
+      }
+    } else if (argc >= 2 && strncmp(command.name, argv[0], space - command.name) == 0 &&
+               argv[0][space - command.name] == '\0' && strcmp(space + 1, argv[1]) == 0) {
+      command.handler(argc - 1, argv + 1);
+      return;
+    }
+  }
+  printf("unknown command '%s', try help\n", argv[0]);
+}
+
+void Shell::task() {
+  char line[LINE_SIZE];
+  uint32_t length = 0;
+  char input[16];
+
+  UART::write("\r\n> ", 4);
+  while (1) {
+    // Yields inside read until something arrives
+    int count = UART::read(input, sizeof(input));
+    for (int i = 0; i < count; i++) {
+      char c = input[i];
+      if (c == '\r' || c == '\n') {
+        if (c == '\n' && length == 0)
+          continue; // second half of a CRLF
+        UART::write("\r\n", 2);
+        line[length] = '\0';
+        execute(line);
+        Stdout::flush();
+        length = 0;
+        UART::write("> ", 2);
+      } else if (c == '\b' || c == 0x7F) {
+        if (length > 0) {
+          length--;
+          UART::write("\b \b", 3);
+        }
+      } else if (c >= ' ' && length < LINE_SIZE - 1) {
+        line[length++] = c;
+        UART::write(&c, 1);
+      }
+    }
+  }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// Command shell on the USART1 console
+//
+// Reads lines with UART::read, which yields while the line is idle, so the task costs
+// nothing between keystrokes. Commands live in a static table in shell.cpp, adding one
+// is a table entry and a handler, nothing is allocated at runtime.
+namespace Shell {
+constexpr uint32_t LINE_SIZE = 64;
+constexpr uint32_t MAX_ARGS = 8;
+
+struct Command {
+  const char *name; // one or two words, "ps" or "trace dump"
+  const char *help;
+  void (*handler)(int argc, char **argv);
+};
+
+void task();
+void execute(char *line);
+} // namespace Shell
@@ -0,0 +1,140 @@
+#include "stdout.hpp"
+
+#include "../peripherals/uart.hpp"
+#include "cycles.hpp"
+#include "scheduler.hpp"
+
+#include <cstring>
+
+namespace Stdout {
+struct Buffer {
+  uint32_t owner; // task id, 0 while the slot is free
+  uint16_t length;
+  uint16_t threshold;
+  Mode mode;
+  char data[BUFFER_SIZE];
+};
+
+// One slot per possible task, only ever touched by the owning task
+Buffer buffers[Scheduler::MAX_TASKS];
+Stats stats = {};
+} // namespace Stdout
+
+// Slot of the running task, claims a free one on first use if claim is set
+static Stdout::Buffer *currentBuffer(bool claim = true) {
+#if ENABLE_STDOUT_BUFFER
+  if (__get_IPSR() != 0 || !Scheduler::active || Scheduler::currentTask == nullptr)
+    return nullptr;
+
+  uint32_t id = Scheduler::currentTask->id;
+  for (Stdout::Buffer &buffer : Stdout::buffers) {
+    if (buffer.owner == id)
+      return &buffer;
+  }
+  if (!claim)
+    return nullptr;
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  Stdout::Buffer *claimed = nullptr;
+  for (Stdout::Buffer &buffer : Stdout::buffers) {
+    if (buffer.owner == 0) {
+      buffer.owner = id;
+      buffer.length = 0;
+      buffer.threshold = Stdout::BUFFER_SIZE;
+      buffer.mode = Stdout::Mode::LINE;
+      claimed = &buffer;
+      break;
+    }
+  }
+  __set_PRIMASK(primask);
+  return claimed;
+#else
+  return nullptr;
+#endif
+}
+
+static void send(const char *data, uint32_t length) {
+  if (length == 0)
+    return;
+  UART::write(data, length);
+  Stdout::stats.flushes++;
+}
+
+// Hand the first length bytes to the UART and keep the rest
+static void drain(Stdout::Buffer &buffer, uint32_t length) {
+  send(buffer.data, length);
+  buffer.length -= length;
+  memmove(buffer.data, buffer.data + length, buffer.length);
+}
+
+int Stdout::write(const char *buf, int count) {
+  if (count <= 0)
+    return 0;
+
+  uint32_t start = Cycles::now();
+  stats.writes++;
+  stats.bytes += count;
+
+  Buffer *buffer = currentBuffer();
+  if (buffer == nullptr) {
+    send(buf, count);
+    stats.cycles += Cycles::since(start);
+    return count;
+  }
+
+  const char *end = buf + count;
+  while (buf < end) {
+    uint32_t len = end - buf;
+    if (len > BUFFER_SIZE - buffer->length)
+      len = BUFFER_SIZE - buffer->length;
+    memcpy(buffer->data + buffer->length, buf, len);
+    buffer->length += len;
+    buf += len;
+
+    if (buffer->length == BUFFER_SIZE) {
+      drain(*buffer, buffer->length);
+    } else if (buffer->mode == Mode::LINE) {
+      uint32_t line = buffer->length;
+      while (line > 0 && buffer->data[line - 1] != '\n')
+        line--;
+      if (line)
+        drain(*buffer, line);
+    } else if (buffer->length >= buffer->threshold) {
+      drain(*buffer, buffer->length);
+    }
+  }
+
+  stats.cycles += Cycles::since(start);
+  return count;
+}
+
+void Stdout::flush() {
+  Buffer *buffer = currentBuffer();
+  if (buffer == nullptr || buffer->length == 0)
+    return;
+
+  uint32_t start = Cycles::now();
+  drain(*buffer, buffer->length);
+  stats.cycles += Cycles::since(start);
+}
+
+void Stdout::release() {
+  Buffer *buffer = currentBuffer(false);
+  if (buffer == nullptr)
+    return;
+
+  flush();
+  buffer->owner = 0;
+}
+
+void Stdout::setMode(Mode mode, uint32_t threshold) {
+  Buffer *buffer = currentBuffer();
+  if (buffer == nullptr)
+    return;
+
+  buffer->mode = mode;
+  buffer->threshold = threshold == 0 || threshold > BUFFER_SIZE ? BUFFER_SIZE : threshold;
+}
+
+Stdout::Stats Stdout::getStats() { return stats; }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-task stdout buffering
+//
+// _write on stdout lands in a small buffer owned by the calling task and only reaches the
+// UART ring as one chunk when a line is complete (LINE) or the buffer passes the task's
+// threshold (THRESHOLD), so a printf with several fields becomes a single DMA transfer.
+// Buffers are claimed on the first write and flushed and released in Scheduler::taskExit.
+// Output from interrupts or before the scheduler runs is written through unbuffered.
+namespace Stdout {
+constexpr size_t BUFFER_SIZE = 128;
+
+enum class Mode : uint8_t {
+  LINE,      // flush up to the last newline
+  THRESHOLD, // flush once at least threshold bytes are buffered
+};
+
+struct Stats {
+  uint32_t writes;  // _write calls on stdout
+  uint32_t flushes; // chunks handed to the UART
+  uint32_t bytes;
+  uint32_t cycles; // core cycles spent in write and flush
+};
+
+int write(const char *buf, int count);
+void flush();
+void release();
+void setMode(Mode mode, uint32_t threshold = BUFFER_SIZE);
+Stats getStats();
+} // namespace Stdout
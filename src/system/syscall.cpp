@@ -40,7 +40,8 @@ void svc_handler(uint32_t *sp) {
     break;
   case SYS_READ:
     if (*(int *)arg0 == FILE_STDIN) {
-      // UART::read(arg1, (char *)arg2, arg3);
+      // Only what has arrived, PendSV can't switch tasks while the handler waits
+      *(int *)arg2 = UART::read((char *)arg1, *(int *)arg2, 0);
     } else {
       *(int *)arg3 = f_read((FIL *)arg0, (char *)arg1, *(int *)arg2, nullptr);
     }
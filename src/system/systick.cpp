@@ -2,6 +2,11 @@
 
 #include "system/clock.hpp"
 
+namespace SystemTick {
+DTCM_BSS uint32_t entryCycles = 0;
+DTCM_BSS uint32_t entryCyclesMax = 0;
+} // namespace SystemTick
+
 // Initialize the system tick
 void SystemTick::init() {
   SysTick->LOAD = (SystemCoreClock / 1000) - 1; // 1ms interval
@@ -3,7 +3,21 @@
 #include "stm32h7xx.h"
 #include "stm32h7xx_hal.h"
 
+#include "tcm.hpp"
+
 namespace SystemTick {
 void init();
-void handler();
+ITCM_FUNC void handler();
+
+// Cycles from the tick event to the first instruction of SysTick_Handler (last/max)
+extern uint32_t entryCycles;
+extern uint32_t entryCyclesMax;
+
+// SysTick counts down from LOAD at core clock, so LOAD - VAL is the latency since the tick
+inline void recordEntry() {
+  uint32_t cycles = SysTick->LOAD - SysTick->VAL;
+  entryCycles = cycles;
+  if (cycles > entryCyclesMax)
+    entryCyclesMax = cycles;
+}
 } // namespace SystemTick
\ No newline at end of file
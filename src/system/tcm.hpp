@@ -0,0 +1,15 @@
+#pragma once
+
+// Placement of hot code and data into the tightly coupled memories.
+// ITCM code is copied from flash by Reset_Handler and runs without flash wait
+// states, DTCM data is single cycle and never cached. DTCM is not reachable by
+// DMA1/DMA2, so DMA buffers must stay in AXI SRAM (.axi_sram).
+#if ENABLE_TCM
+#define ITCM_FUNC __attribute__((section(".itcm_text"), noinline))
+#define DTCM_DATA __attribute__((section(".dtcm_data")))
+#define DTCM_BSS  __attribute__((section(".dtcm_bss")))
+#else
+#define ITCM_FUNC
+#define DTCM_DATA
+#define DTCM_BSS
+#endif
@@ -0,0 +1,191 @@
+#include "telemetry.hpp"
+
+#include "../peripherals/crc.hpp"
+#include "../peripherals/uart.hpp"
+#include "cycles.hpp"
+#include "scheduler.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+namespace Telemetry {
+Slot slots[SLOT_COUNT];
+std::atomic<uint32_t> head{0}; // next position producers claim
+uint32_t tail = 0;             // next position the telemetry task sends
+uint8_t sequence = 0;          // per frame, lets the host count lost frames
+std::atomic<uint32_t> dropped{0};
+uint32_t records = 0;
+uint32_t bytes = 0;
+} // namespace Telemetry
+
+static_assert((Telemetry::SLOT_COUNT & (Telemetry::SLOT_COUNT - 1)) == 0, "SLOT_COUNT must be a power of two");
+
+// Worst case COBS overhead is one byte per 254, plus start byte and delimiter
+constexpr size_t FRAME_BODY_MAX = 2 + Telemetry::PAYLOAD_MAX + 4;
+constexpr size_t FRAME_MAX = 1 + FRAME_BODY_MAX + FRAME_BODY_MAX / 254 + 1 + 1;
+// Frames are collected and handed to the UART in batches of up to this size
+constexpr size_t BATCH_SIZE = 256;
+
+void Telemetry::init() {
+  CRC32::init();
+  for (uint32_t i = 0; i < SLOT_COUNT; i++)
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+Telemetry::Record *Telemetry::acquire(uint8_t channel) {
+  uint32_t position = head.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot &slot = slots[position & (SLOT_COUNT - 1)];
+    int32_t diff = (int32_t)(slot.sequence.load(std::memory_order_acquire) - position);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        slot.position = position;
+        slot.record.channel = channel;
+        return &slot.record;
+      }
+    } else if (diff < 0) {
+      // The telemetry task has not sent this slot from the previous lap yet
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      position = head.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void Telemetry::commit(Record *record, size_t length) {
+  Slot *slot = reinterpret_cast<Slot *>(reinterpret_cast<uint8_t *>(record) - offsetof(Slot, record));
+  record->length = length > PAYLOAD_MAX ? PAYLOAD_MAX : length;
+  slot->sequence.store(slot->position + 1, std::memory_order_release);
+}
+
+bool Telemetry::send(uint8_t channel, const void *data, size_t length) {
+  Record *record = acquire(channel);
+  if (record == nullptr)
+    return false;
+  if (length > PAYLOAD_MAX)
+    length = PAYLOAD_MAX;
+  memcpy(record->payload, data, length);
+  commit(record, length);
+  return true;
+}
+
+// COBS encode length bytes from in to out, returns the encoded size, never writes 0x00
+static size_t cobsEncode(const uint8_t *in, size_t length, uint8_t *out) {
+  uint8_t *code = out;
+  uint8_t *dst = out + 1;
+  uint8_t run = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (in[i] != 0) {
+      *dst++ = in[i];
+      run++;
+    }
+    if (in[i] == 0 || run == 0xFF) {
+      *code = run;
+      code = dst++;
+      run = 1;
+    }
+  }
+  *code = run;
+  return dst - out;
+}
+
+// Append the frame for one record to out, returns its size
+static size_t encodeFrame(const Telemetry::Record &record, uint8_t *out) {
+  uint8_t body[FRAME_BODY_MAX];
+  body[0] = record.channel;
+  body[1] = Telemetry::sequence++;
+  memcpy(&body[2], record.payload, record.length);
+  size_t length = 2 + record.length;
+  uint32_t crc = CRC32::calculate(body, length);
+  memcpy(&body[length], &crc, sizeof(crc));
+  length += sizeof(crc);
+
+  out[0] = Telemetry::FRAME_START;
+  size_t size = 1 + cobsEncode(body, length, out + 1);
+  out[size++] = 0x00;
+  return size;
+}
+
+// Load and stack watermark of every task, split over as many records as the tasks need
+static void sendTaskStats(uint32_t *lastCycles, uint32_t *lastIds, uint32_t window) {
+  constexpr size_t ENTRY_SIZE = 8;
+  Telemetry::Record *record = nullptr;
+  size_t length = 0;
+
+  for (uint32_t i = 0; i < Scheduler::taskCount; i++) {
+    const TCB &task = Scheduler::tasks[i];
+    uint32_t cycles = Scheduler::runCycles[i];
+    uint16_t load = 0;
+    if (lastIds[i] == task.id && window)
+      load = (uint64_t)(cycles - lastCycles[i]) * 1000 / window;
+    lastIds[i] = task.id;
+    lastCycles[i] = cycles;
+
+    // A full queue loses this record's tasks, the load windows above stay correct
+    if (length == 0)
+      record = Telemetry::acquire(Telemetry::CHANNEL_TASK_STATS);
+    if (record != nullptr) {
+      uint16_t stack = Scheduler::stackFree(task);
+      memcpy(&record->payload[length], &task.id, 4);
+      memcpy(&record->payload[length + 4], &load, 2);
+      memcpy(&record->payload[length + 6], &stack, 2);
+    }
+    length += ENTRY_SIZE;
+
+    if (length + ENTRY_SIZE > Telemetry::PAYLOAD_MAX || i == Scheduler::taskCount - 1) {
+      if (record != nullptr)
+        Telemetry::commit(record, length);
+      record = nullptr;
+      length = 0;
+    }
+  }
+}
+
+void Telemetry::task() {
+  // UART::write copies into the DMA ring, the batch can live on the task stack
+  uint8_t batch[BATCH_SIZE];
+  uint32_t lastCycles[Scheduler::MAX_TASKS] = {};
+  uint32_t lastIds[Scheduler::MAX_TASKS] = {};
+  uint32_t lastStats = Cycles::now();
+
+  while (1) {
+    uint32_t elapsed = Cycles::since(lastStats);
+    if (elapsed >= SystemCoreClock) {
+      sendTaskStats(lastCycles, lastIds, elapsed);
+      lastStats += elapsed;
+    }
+
+    size_t used = 0;
+    for (;;) {
+      Slot &slot = slots[tail & (SLOT_COUNT - 1)];
+      if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+        break; // empty, or the producer is still writing
+
+      if (used + FRAME_MAX > BATCH_SIZE) {
+        UART::write((const char *)batch, used);
+        bytes += used;
+        used = 0;
+      }
+      used += encodeFrame(slot.record, batch + used);
+      records++;
+
+      slot.sequence.store(tail + SLOT_COUNT, std::memory_order_release);
+      tail++;
+    }
+
+    if (used) {
+      UART::write((const char *)batch, used);
+      bytes += used;
+    }
+    Scheduler::yield();
+  }
+}
+
+Telemetry::Stats Telemetry::getStats() {
+  Stats stats;
+  stats.records = records;
+  stats.dropped = dropped.load(std::memory_order_relaxed);
+  stats.bytes = bytes;
+  return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Binary telemetry channel multiplexed on USART1
+//
+// Producers (tasks or interrupts) acquire a record slot, write their payload straight into
+// it and commit it. The telemetry task drains committed records in order, appends a CRC-32
+// from the CRC unit and sends each one COBS encoded:
+//
+//   0xFE | COBS(channel | sequence | payload | crc32) | 0x00
+//
+// 0xFE never appears in UTF-8 text and COBS removes every 0x00 from the body, so frames
+// share the console with printf text and log frames (0xFF). scripts/telemetry_receive.py
+// decodes and validates the stream on the host.
+namespace Telemetry {
+constexpr uint8_t FRAME_START = 0xFE;
+constexpr size_t PAYLOAD_MAX = 56;
+constexpr uint32_t SLOT_COUNT = 32; // power of two
+
+enum Channel : uint8_t {
+  CHANNEL_ADC = 1,         // uint16_t millivolt samples
+  CHANNEL_TEMPERATURE = 2, // float degrees Celsius
+  CHANNEL_TASK_STATS = 3,  // per task: uint32_t id, uint16_t CPU load in 0.1 %, uint16_t free stack words,
+                           // 7 tasks per record, more tasks take more records
+};
+
+struct Record {
+  uint8_t channel;
+  uint8_t length;
+  uint8_t payload[PAYLOAD_MAX];
+};
+
+// Bounded multi-producer queue slot, sequence tells producers and the consumer who owns it
+struct Slot {
+  std::atomic<uint32_t> sequence;
+  uint32_t position;
+  Record record;
+};
+
+struct Stats {
+  uint32_t records;
+  uint32_t dropped; // acquire found the queue full
+  uint32_t bytes;   // encoded bytes handed to the UART
+};
+
+void init();
+// Returns nullptr if the queue is full, the record must be committed
+Record *acquire(uint8_t channel);
+void commit(Record *record, size_t length);
+// Copying convenience wrapper around acquire and commit
+bool send(uint8_t channel, const void *data, size_t length);
+void task();
+Stats getStats();
+
+extern Slot slots[SLOT_COUNT];
+} // namespace Telemetry